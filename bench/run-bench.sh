@@ -0,0 +1,21 @@
+#!/bin/sh
+# Usage: run-bench.sh FIRMWARE HOST_EMULATOR HARNESS PROGRAM...
+# Prints a tab-separated table with one row per ChipOS program.
+# Each program is imported as the file BENCH into a fresh storage
+# image, which the benchmark firmware runs at boot.
+
+FIRMWARE="$1"
+EMULATOR="$2"
+HARNESS="$3"
+shift 3
+
+IMAGE=$(mktemp)
+trap 'rm -f "$IMAGE"' EXIT
+
+printf 'program\tstatus\tcycles\tmilliseconds\n'
+for PROGRAM in "$@"; do
+    NAME=$(basename "$PROGRAM" .txt)
+    rm -f "$IMAGE"
+    "$EMULATOR" -i BENCH="$PROGRAM" "$IMAGE" > /dev/null || exit 1
+    "$HARNESS" "$FIRMWARE" "$IMAGE" "$NAME" || exit 1
+done
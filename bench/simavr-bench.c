@@ -0,0 +1,122 @@
+
+// Runs a benchmark build of the firmware (main-bench.elf) inside simavr
+// and prints one tab-separated row with the AVR cycles spent in runFile.
+// The 25LC256 EEPROM model of the host emulator (emulator/eeprom.c) is
+// attached to the SPI bus and loaded from an image created with
+// chipos-host. The benchmark build answers key waits itself, so that
+// print: and error messages do not block.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_io.h"
+#include "avr_spi.h"
+#include "avr_ioport.h"
+#include "../emulator/eeprom.h"
+
+#define CPU_FREQUENCY 8000000
+#define MAXIMUM_SIMULATED_SECONDS 600
+
+// Port B pin 1 selects the EEPROM.
+#define STORAGE_CHIP_SELECT_PIN 1
+
+// GPIOR0 in data space. Values match BENCHMARK_MARKER_* in main.c.
+#define BENCHMARK_MARKER_ADDRESS 0x3E
+#define BENCHMARK_MARKER_START 1
+#define BENCHMARK_MARKER_END 2
+#define BENCHMARK_MARKER_ERROR 3
+#define BENCHMARK_MARKER_MISSING_FILE 4
+
+static const char * const BENCHMARK_STATUS_NAME_LIST[] = {
+    "timeout",
+    "running",
+    "ok",
+    "error",
+    "missing"
+};
+
+static avr_t *avr;
+static avr_irq_t *spiInputIrq;
+
+static int benchmarkStatus = 0;
+static avr_cycle_count_t benchmarkStartCycle = 0;
+static avr_cycle_count_t benchmarkEndCycle = 0;
+
+static void handleStorageChipSelect(struct avr_irq_t *irq, uint32_t value, void *param) {
+    setEepromChipSelect(value == 0);
+}
+
+static void handleSpiOutput(struct avr_irq_t *irq, uint32_t value, void *param) {
+    avr_raise_irq(spiInputIrq, transferEepromInt8(value));
+}
+
+static void handleBenchmarkMarker(struct avr_t *avr, avr_io_addr_t address, uint8_t value, void *param) {
+    avr->data[address] = value;
+    if (value == BENCHMARK_MARKER_START || value == BENCHMARK_MARKER_MISSING_FILE) {
+        benchmarkStartCycle = avr->cycle;
+    }
+    benchmarkEndCycle = avr->cycle;
+    benchmarkStatus = value;
+}
+
+static void loadStorageImage(const char *path) {
+    FILE *tempFile = fopen(path, "rb");
+    if (tempFile == NULL) {
+        perror(path);
+        exit(1);
+    }
+    if (fread(eepromData, 1, sizeof(eepromData), tempFile) != sizeof(eepromData)) {
+        fprintf(stderr, "%s: expected %d bytes.\n", path, EEPROM_SIZE);
+        exit(1);
+    }
+    fclose(tempFile);
+}
+
+int main(int argc, char **argv) {
+    if (argc != 4) {
+        fprintf(stderr, "Usage: %s FIRMWARE IMAGE NAME\n", argv[0]);
+        return 1;
+    }
+    elf_firmware_t tempFirmware;
+    memset(&tempFirmware, 0, sizeof(tempFirmware));
+    if (elf_read_firmware(argv[1], &tempFirmware) != 0) {
+        fprintf(stderr, "%s: could not read firmware.\n", argv[1]);
+        return 1;
+    }
+    loadStorageImage(argv[2]);
+    avr = avr_make_mcu_by_name("atmega328p");
+    if (avr == NULL) {
+        fprintf(stderr, "simavr does not support atmega328p.\n");
+        return 1;
+    }
+    avr_init(avr);
+    avr_load_firmware(avr, &tempFirmware);
+    avr->frequency = CPU_FREQUENCY;
+
+    spiInputIrq = avr_io_getirq(avr, AVR_IOCTL_SPI_GETIRQ(0), SPI_IRQ_INPUT);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_SPI_GETIRQ(0), SPI_IRQ_OUTPUT), handleSpiOutput, NULL);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), STORAGE_CHIP_SELECT_PIN), handleStorageChipSelect, NULL);
+
+    avr_register_io_write(avr, BENCHMARK_MARKER_ADDRESS, handleBenchmarkMarker, NULL);
+
+    avr_cycle_count_t tempMaximumCycle = (avr_cycle_count_t)CPU_FREQUENCY * MAXIMUM_SIMULATED_SECONDS;
+    while (benchmarkStatus <= BENCHMARK_MARKER_START) {
+        int tempState = avr_run(avr);
+        if (tempState == cpu_Done || tempState == cpu_Crashed) {
+            fprintf(stderr, "%s: firmware stopped.\n", argv[3]);
+            return 1;
+        }
+        if (avr->cycle > tempMaximumCycle) {
+            benchmarkStatus = 0;
+            benchmarkEndCycle = avr->cycle;
+            break;
+        }
+    }
+    avr_cycle_count_t tempCycleAmount = benchmarkEndCycle - benchmarkStartCycle;
+    printf("%s\t%s\t%llu\t%.3f\n", argv[3], BENCHMARK_STATUS_NAME_LIST[benchmarkStatus],
+        (unsigned long long)tempCycleAmount, tempCycleAmount * 1000.0 / CPU_FREQUENCY);
+    return 0;
+}
+
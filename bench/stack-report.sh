@@ -0,0 +1,54 @@
+#!/bin/sh
+# Usage: stack-report.sh STACK_USAGE_FILE [FREE_BYTES]
+# Reads the -fstack-usage output of main.c (main.su) and prints the
+# native stack consumed by each level of expression nesting and of
+# func: recursion. FREE_BYTES is the "Native" memory statistic shown
+# after running a file. When it is given, the report also estimates
+# how many more levels fit before "Expression too complex".
+
+STACK_USAGE_FILE="$1"
+FREE_BYTES="${2:-}"
+
+if [ ! -f "$STACK_USAGE_FILE" ]; then
+    echo "Usage: $0 STACK_USAGE_FILE [FREE_BYTES]" >&2
+    exit 1
+fi
+
+awk -F '\t' -v freeBytes="$FREE_BYTES" '
+# Each call pushes a two byte return address, which is not part of
+# the frame sizes reported by gcc. nativeStackHasCollision keeps a
+# margin of 100 bytes.
+BEGIN {
+    CALL_SIZE = 2
+    COLLISION_MARGIN = 100
+}
+{
+    split($1, tempField, ":")
+    frameSize[tempField[length(tempField)]] = $2
+}
+function printChain(title, chain,    tempName, tempList, tempAmount, tempIndex, total) {
+    tempAmount = split(chain, tempList, " ")
+    total = 0
+    printf "%s\n", title
+    for (tempIndex = 1; tempIndex <= tempAmount; tempIndex += 1) {
+        tempName = tempList[tempIndex]
+        if (!(tempName in frameSize)) {
+            printf "    %-36s missing (inlined?)\n", tempName
+            continue
+        }
+        printf "    %-36s %5d\n", tempName, frameSize[tempName] + CALL_SIZE
+        total += frameSize[tempName] + CALL_SIZE
+    }
+    printf "    %-36s %5d\n", "bytes per level", total
+    if (freeBytes != "" && total > 0) {
+        printf "    %-36s %5d\n", "more levels", int((freeBytes - COLLISION_MARGIN) / total)
+    }
+    return total
+}
+END {
+    printChain("Operator nesting:", "evaluateExpression evaluateBinaryOperatorExpression1")
+    printChain("Function argument nesting:", "evaluateExpression evaluateFunction")
+    printChain("Operator inside function argument:", "evaluateExpression evaluateFunction evaluateExpression evaluateBinaryOperatorExpression1")
+    printChain("func: recursion:", "evaluateExpression evaluateFunction runCode evaluateExpression")
+}
+' "$STACK_USAGE_FILE"
@@ -0,0 +1,110 @@
+// Model of the 25LC256 SPI EEPROM. See eeprom.h.
+
+#include <string.h>
+#include "eeprom.h"
+
+#define EEPROM_STATE_COMMAND 0
+#define EEPROM_STATE_ADDRESS_HIGH 1
+#define EEPROM_STATE_ADDRESS_LOW 2
+#define EEPROM_STATE_DATA 3
+#define EEPROM_STATE_IGNORE 4
+
+#define EEPROM_COMMAND_READ 0x03
+#define EEPROM_COMMAND_WRITE 0x02
+#define EEPROM_COMMAND_WRITE_ENABLE 0x06
+#define EEPROM_COMMAND_READ_STATUS 0x05
+
+// A page program keeps the write-in-progress bit set until this many
+// more bytes have crossed the bus. This stands in for the 5 ms write
+// cycle. Like the real chip, the model ignores every command except
+// status reads until the cycle ends.
+#define EEPROM_WRITE_CYCLE_TRANSFERS 32
+
+unsigned char eepromData[EEPROM_SIZE];
+
+static int eepromIsSelected = 0;
+static int eepromState = EEPROM_STATE_COMMAND;
+static unsigned char eepromCommand;
+static int eepromAddress;
+static int eepromWriteIsEnabled = 0;
+static unsigned char eepromPage[EEPROM_PAGE_SIZE];
+static unsigned char eepromPageIsWritten[EEPROM_PAGE_SIZE];
+static int eepromPageAddress = -1;
+static int eepromWriteCycleLeft = 0;
+
+static void commitEepromPage() {
+    if (eepromPageAddress < 0) {
+        return;
+    }
+    int index = 0;
+    while (index < EEPROM_PAGE_SIZE) {
+        if (eepromPageIsWritten[index]) {
+            eepromData[eepromPageAddress + index] = eepromPage[index];
+            eepromWriteCycleLeft = EEPROM_WRITE_CYCLE_TRANSFERS;
+        }
+        index += 1;
+    }
+    eepromPageAddress = -1;
+    eepromWriteIsEnabled = 0;
+}
+
+void setEepromChipSelect(int isSelected) {
+    if (isSelected && !eepromIsSelected) {
+        eepromState = EEPROM_STATE_COMMAND;
+    }
+    if (!isSelected && eepromIsSelected) {
+        commitEepromPage();
+    }
+    eepromIsSelected = isSelected;
+}
+
+unsigned char transferEepromInt8(unsigned char value) {
+    unsigned char output = 0xFF;
+    if (eepromWriteCycleLeft > 0) {
+        eepromWriteCycleLeft -= 1;
+    }
+    if (!eepromIsSelected) {
+        return output;
+    }
+    if (eepromState == EEPROM_STATE_COMMAND) {
+        eepromCommand = value;
+        if (eepromWriteCycleLeft > 0 && value != EEPROM_COMMAND_READ_STATUS) {
+            eepromState = EEPROM_STATE_IGNORE;
+        } else if (value == EEPROM_COMMAND_READ || value == EEPROM_COMMAND_WRITE) {
+            eepromState = EEPROM_STATE_ADDRESS_HIGH;
+        } else if (value == EEPROM_COMMAND_READ_STATUS) {
+            eepromState = EEPROM_STATE_DATA;
+        } else {
+            if (value == EEPROM_COMMAND_WRITE_ENABLE) {
+                eepromWriteIsEnabled = 1;
+            }
+            eepromState = EEPROM_STATE_IGNORE;
+        }
+    } else if (eepromState == EEPROM_STATE_ADDRESS_HIGH) {
+        eepromAddress = value << 8;
+        eepromState = EEPROM_STATE_ADDRESS_LOW;
+    } else if (eepromState == EEPROM_STATE_ADDRESS_LOW) {
+        eepromAddress = (eepromAddress | value) % EEPROM_SIZE;
+        eepromState = EEPROM_STATE_DATA;
+        if (eepromCommand == EEPROM_COMMAND_WRITE && eepromWriteIsEnabled) {
+            eepromPageAddress = eepromAddress - eepromAddress % EEPROM_PAGE_SIZE;
+            memset(eepromPageIsWritten, 0, sizeof(eepromPageIsWritten));
+        }
+    } else if (eepromState == EEPROM_STATE_DATA) {
+        if (eepromCommand == EEPROM_COMMAND_READ) {
+            output = eepromData[eepromAddress];
+            eepromAddress = (eepromAddress + 1) % EEPROM_SIZE;
+        } else if (eepromCommand == EEPROM_COMMAND_WRITE) {
+            if (eepromPageAddress >= 0) {
+                // Page writes wrap around inside the page.
+                int tempOffset = eepromAddress - eepromPageAddress;
+                eepromPage[tempOffset] = value;
+                eepromPageIsWritten[tempOffset] = 1;
+                eepromAddress = eepromPageAddress + (tempOffset + 1) % EEPROM_PAGE_SIZE;
+            }
+        } else if (eepromCommand == EEPROM_COMMAND_READ_STATUS) {
+            output = (eepromWriteIsEnabled << 1) | (eepromWriteCycleLeft > 0);
+        }
+    }
+    return output;
+}
@@ -0,0 +1,16 @@
+// Model of the 25LC256 SPI EEPROM, shared by the host emulator and
+// the simavr benchmark harness. The caller loads and saves
+// eepromData, and forwards chip select changes and SPI bytes.
+
+#ifndef EEPROM_H
+#define EEPROM_H
+
+#define EEPROM_SIZE 32768
+#define EEPROM_PAGE_SIZE 64
+
+extern unsigned char eepromData[EEPROM_SIZE];
+
+void setEepromChipSelect(int isSelected);
+unsigned char transferEepromInt8(unsigned char value);
+
+#endif
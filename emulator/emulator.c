@@ -0,0 +1,441 @@
+
+// Host implementation of the ChipOS hardware.
+// The 25LC256 EEPROM (eeprom.c) is emulated at the SPI byte level and
+// backed by an image file, the HD44780 display is an in-memory framebuffer,
+// and key presses come from a script file.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "emulator.h"
+#include "eeprom.h"
+
+#define EMULATOR_DISPLAY_WIDTH 16
+#define EMULATOR_DISPLAY_HEIGHT 2
+#define EMULATOR_KEY_QUEUE_MAXIMUM_LENGTH 4096
+#define EMULATOR_STACK_SIZE (1024 * 1024)
+
+// Indexed by the KEY_* values in main.c.
+static const char * const EMULATOR_KEY_NAME_LIST[] = {
+    "LEFT",
+    "RIGHT",
+    "UP",
+    "DOWN",
+    "SYMBOL_LEFT",
+    "SYMBOL_RIGHT",
+    "SYMBOL_UP",
+    "SYMBOL_DOWN",
+    "SELECT",
+    "DELETE",
+    "NEWLINE",
+    "ESCAPE",
+    "FINISH",
+    "CLEAR_LINE"
+};
+
+#define EMULATOR_KEY_AMOUNT (sizeof(EMULATOR_KEY_NAME_LIST) / sizeof(*EMULATOR_KEY_NAME_LIST))
+
+unsigned char DDRB;
+unsigned char PORTB;
+unsigned char DDRC;
+unsigned char PORTC;
+unsigned char DDRD;
+unsigned char PORTD;
+unsigned char PIND;
+unsigned char SPCR;
+unsigned char SPSR;
+unsigned char SPDR;
+unsigned char TCCR1B;
+
+char *testOutput = NULL;
+
+static const char *storageImagePath = NULL;
+
+static char displayBuffer[EMULATOR_DISPLAY_HEIGHT][EMULATOR_DISPLAY_WIDTH];
+static int displayAddress = 0;
+static int displayIsWritingCharacterMemory = 0;
+
+static char keyQueue[EMULATOR_KEY_QUEUE_MAXIMUM_LENGTH];
+static int keyQueueLength = 0;
+static int keyQueueIndex = 0;
+static int keyIsReleased = 0;
+
+// Stack addresses are kept as integers because they outlive the
+// frames they were taken from.
+static uintptr_t stackBase;
+static uintptr_t deepestStackMarker;
+
+char *itoa(int value, char *destination, int radix) {
+    char tempBuffer[40];
+    unsigned int tempValue = (value < 0 && radix == 10) ? -(unsigned int)value : (unsigned int)value;
+    int index = 0;
+    do {
+        int tempDigit = tempValue % radix;
+        tempBuffer[index] = (tempDigit < 10) ? '0' + tempDigit : 'a' + tempDigit - 10;
+        tempValue /= radix;
+        index += 1;
+    } while (tempValue > 0);
+    int tempLength = 0;
+    if (value < 0 && radix == 10) {
+        destination[tempLength] = '-';
+        tempLength += 1;
+    }
+    while (index > 0) {
+        index -= 1;
+        destination[tempLength] = tempBuffer[index];
+        tempLength += 1;
+    }
+    destination[tempLength] = 0;
+    return destination;
+}
+
+char *ltoa(long value, char *destination, int radix) {
+    if (value < 0 && radix == 10) {
+        destination[0] = '-';
+        ultoa(-(unsigned long)value, destination + 1, radix);
+        return destination;
+    }
+    return ultoa((unsigned long)value, destination, radix);
+}
+
+char *ultoa(unsigned long value, char *destination, int radix) {
+    char tempBuffer[70];
+    int index = 0;
+    do {
+        int tempDigit = value % radix;
+        tempBuffer[index] = (tempDigit < 10) ? '0' + tempDigit : 'a' + tempDigit - 10;
+        value /= radix;
+        index += 1;
+    } while (value > 0);
+    int tempLength = 0;
+    while (index > 0) {
+        index -= 1;
+        destination[tempLength] = tempBuffer[index];
+        tempLength += 1;
+    }
+    destination[tempLength] = 0;
+    return destination;
+}
+
+char *dtostrf(double value, signed char width, unsigned char precision, char *destination) {
+    sprintf(destination, "%*.*f", width, precision, value);
+    return destination;
+}
+
+static void printSymbolText(FILE *file, const char *text) {
+    int index = 0;
+    while (text[index] != 0) {
+        unsigned char tempSymbol = text[index];
+        const char *tempText = getEmulatorSymbolText(tempSymbol);
+        if (tempText != NULL) {
+            fputs(tempText, file);
+        } else {
+            fputc(tempSymbol, file);
+        }
+        index += 1;
+    }
+}
+
+static void printDisplay(FILE *file) {
+    fputs("+----------------+\n", file);
+    int tempPosY = 0;
+    while (tempPosY < EMULATOR_DISPLAY_HEIGHT) {
+        fputc('|', file);
+        int tempPosX = 0;
+        while (tempPosX < EMULATOR_DISPLAY_WIDTH) {
+            char tempCharacter = displayBuffer[tempPosY][tempPosX];
+            // Custom characters programmed by main.
+            if (tempCharacter == 1) {
+                tempCharacter = '\\';
+            } else if (tempCharacter == 2) {
+                tempCharacter = '~';
+            } else if (tempCharacter < ' ') {
+                tempCharacter = ' ';
+            }
+            fputc(tempCharacter, file);
+            tempPosX += 1;
+        }
+        fputs("|\n", file);
+        tempPosY += 1;
+    }
+    fputs("+----------------+\n", file);
+}
+
+static void flushTestOutput() {
+    if (testOutput == NULL) {
+        return;
+    }
+    printSymbolText(stdout, testOutput);
+    fputc('\n', stdout);
+    testOutput = NULL;
+}
+
+static void saveStorageImage() {
+    if (storageImagePath == NULL) {
+        return;
+    }
+    FILE *tempFile = fopen(storageImagePath, "wb");
+    if (tempFile == NULL) {
+        perror(storageImagePath);
+        return;
+    }
+    fwrite(eepromData, 1, sizeof(eepromData), tempFile);
+    fclose(tempFile);
+}
+
+static void finishEmulator() {
+    flushTestOutput();
+    printDisplay(stdout);
+    saveStorageImage();
+}
+
+static void loadStorageImage(const char *path) {
+    memset(eepromData, 0xFF, sizeof(eepromData));
+    storageImagePath = path;
+    FILE *tempFile = fopen(path, "rb");
+    if (tempFile == NULL) {
+        return;
+    }
+    size_t tempSize = fread(eepromData, 1, sizeof(eepromData), tempFile);
+    fclose(tempFile);
+    if (tempSize != sizeof(eepromData)) {
+        fprintf(stderr, "%s: expected %d bytes, found %d.\n", path, EEPROM_SIZE, (int)tempSize);
+        exit(1);
+    }
+}
+
+static char *readHostFile(const char *path) {
+    FILE *tempFile = fopen(path, "rb");
+    if (tempFile == NULL) {
+        perror(path);
+        exit(1);
+    }
+    fseek(tempFile, 0, SEEK_END);
+    long tempSize = ftell(tempFile);
+    fseek(tempFile, 0, SEEK_SET);
+    char *output = malloc(tempSize + 1);
+    if (fread(output, 1, tempSize, tempFile) != (size_t)tempSize) {
+        perror(path);
+        exit(1);
+    }
+    output[tempSize] = 0;
+    fclose(tempFile);
+    return output;
+}
+
+static void loadKeyScript(const char *path) {
+    char *tempText = readHostFile(path);
+    char *tempName = strtok(tempText, " \t\r\n");
+    while (tempName != NULL) {
+        if (tempName[0] == '#') {
+            // Comments run to the end of the line.
+            tempName = strtok(NULL, "\r\n");
+        } else {
+            int index = 0;
+            while (index < EMULATOR_KEY_AMOUNT) {
+                if (strcmp(tempName, EMULATOR_KEY_NAME_LIST[index]) == 0) {
+                    break;
+                }
+                index += 1;
+            }
+            if (index >= EMULATOR_KEY_AMOUNT) {
+                fprintf(stderr, "%s: unknown key \"%s\".\n", path, tempName);
+                exit(1);
+            }
+            if (keyQueueLength >= EMULATOR_KEY_QUEUE_MAXIMUM_LENGTH) {
+                fprintf(stderr, "%s: too many keys.\n", path);
+                exit(1);
+            }
+            keyQueue[keyQueueLength] = index;
+            keyQueueLength += 1;
+        }
+        tempName = strtok(NULL, " \t\r\n");
+    }
+    free(tempText);
+}
+
+// Converts keyword text such as "while:" into the symbols
+// which the text editor would have inserted.
+static void convertTextToSymbols(char *text) {
+    int tempReadIndex = 0;
+    int tempWriteIndex = 0;
+    while (text[tempReadIndex] != 0) {
+        if (text[tempReadIndex] == '\r') {
+            tempReadIndex += 1;
+            continue;
+        }
+        int tempBestSymbol = -1;
+        int tempBestLength = 1;
+        int tempSymbol = 128;
+        while (tempSymbol < 256) {
+            const char *tempText = getEmulatorSymbolText(tempSymbol);
+            if (tempText == NULL) {
+                break;
+            }
+            int tempLength = strlen(tempText);
+            if (tempLength > tempBestLength && strncmp(text + tempReadIndex, tempText, tempLength) == 0) {
+                tempBestSymbol = tempSymbol;
+                tempBestLength = tempLength;
+            }
+            tempSymbol += 1;
+        }
+        if (tempBestSymbol < 0) {
+            text[tempWriteIndex] = text[tempReadIndex];
+        } else {
+            text[tempWriteIndex] = tempBestSymbol;
+        }
+        tempReadIndex += tempBestLength;
+        tempWriteIndex += 1;
+    }
+    text[tempWriteIndex] = 0;
+}
+
+static void importHostFile(char *argument) {
+    char *tempSeparator = strchr(argument, '=');
+    if (tempSeparator == NULL) {
+        fprintf(stderr, "Expected NAME=PATH, found \"%s\".\n", argument);
+        exit(1);
+    }
+    *tempSeparator = 0;
+    char *tempText = readHostFile(tempSeparator + 1);
+    convertTextToSymbols(tempText);
+    if (!importEmulatorFile(argument, tempText)) {
+        fprintf(stderr, "Could not import \"%s\".\n", argument);
+        exit(1);
+    }
+    free(tempText);
+}
+
+static void printUsage(const char *program) {
+    fprintf(stderr, "Usage: %s [-k KEY_SCRIPT] [-i NAME=PATH]... [-r NAME] IMAGE\n", program);
+    fprintf(stderr, "  -k  Read key presses from KEY_SCRIPT.\n");
+    fprintf(stderr, "  -i  Write the text file PATH into the file NAME.\n");
+    fprintf(stderr, "  -r  Run the file NAME, then exit.\n");
+    exit(1);
+}
+
+void initializeEmulator(int argc, char **argv) {
+    char tempStackMarker;
+    stackBase = (uintptr_t)&tempStackMarker;
+    const char *tempKeyScriptPath = NULL;
+    char *tempRunName = NULL;
+    int tempImportAmount = 0;
+    char *tempImportList[argc];
+    int index = 1;
+    while (index < argc - 1) {
+        if (strcmp(argv[index], "-k") == 0) {
+            tempKeyScriptPath = argv[index + 1];
+        } else if (strcmp(argv[index], "-i") == 0) {
+            tempImportList[tempImportAmount] = argv[index + 1];
+            tempImportAmount += 1;
+        } else if (strcmp(argv[index], "-r") == 0) {
+            tempRunName = argv[index + 1];
+        } else {
+            printUsage(argv[0]);
+        }
+        index += 2;
+    }
+    if (index != argc - 1) {
+        printUsage(argv[0]);
+    }
+    memset(displayBuffer, ' ', sizeof(displayBuffer));
+    loadStorageImage(argv[index]);
+    initializeEmulatorStorage();
+    if (tempKeyScriptPath != NULL) {
+        loadKeyScript(tempKeyScriptPath);
+    }
+    atexit(finishEmulator);
+    index = 0;
+    while (index < tempImportAmount) {
+        importHostFile(tempImportList[index]);
+        index += 1;
+    }
+    if (tempRunName != NULL) {
+        if (!runEmulatorFile(tempRunName)) {
+            fprintf(stderr, "Missing file \"%s\".\n", tempRunName);
+            exit(1);
+        }
+        exit(0);
+    }
+}
+
+void setEmulatorStorageChipSelect(int isSelected) {
+    setEepromChipSelect(isSelected);
+}
+
+unsigned char transferEmulatorSpiInt8(unsigned char value) {
+    return transferEepromInt8(value);
+}
+
+void sendEmulatorDisplayCommand(unsigned char data) {
+    if (data == 0x01) {
+        memset(displayBuffer, ' ', sizeof(displayBuffer));
+        displayAddress = 0;
+        displayIsWritingCharacterMemory = 0;
+    } else if (data & 0x80) {
+        displayAddress = data & 0x7F;
+        displayIsWritingCharacterMemory = 0;
+    } else if (data & 0x40) {
+        displayIsWritingCharacterMemory = 1;
+    }
+}
+
+void sendEmulatorDisplayCharacter(unsigned char data) {
+    if (displayIsWritingCharacterMemory) {
+        return;
+    }
+    int tempPosX = displayAddress % 64;
+    int tempPosY = displayAddress / 64;
+    if (tempPosX < EMULATOR_DISPLAY_WIDTH && tempPosY < EMULATOR_DISPLAY_HEIGHT) {
+        displayBuffer[tempPosY][tempPosX] = data;
+    }
+    displayAddress = (displayAddress + 1) & 0x7F;
+}
+
+// Every scripted key is reported as pressed for exactly one poll,
+// with a released poll in between, so that getKey never sees a
+// held key and never starts repeating it.
+char getEmulatorPressedKey(void) {
+    flushTestOutput();
+    if (!keyIsReleased) {
+        keyIsReleased = 1;
+        return -1;
+    }
+    if (keyQueueIndex >= keyQueueLength) {
+        exit(0);
+    }
+    keyIsReleased = 0;
+    char output = keyQueue[keyQueueIndex];
+    keyQueueIndex += 1;
+    return output;
+}
+
+char emulatorEscapeKeyIsPressed(void) {
+    return 0;
+}
+
+// The host cannot paint its stack safely. Instead, the deepest
+// stack seen by the collision checks stands in for the watermark.
+char emulatorNativeStackHasCollision(int offset) {
+    char tempStackMarker;
+    uintptr_t tempAddress = (uintptr_t)&tempStackMarker;
+    if (tempAddress < deepestStackMarker) {
+        deepestStackMarker = tempAddress;
+    }
+    return (long)(stackBase - tempAddress) + offset > EMULATOR_STACK_SIZE;
+}
+
+void paintEmulatorNativeStack(void) {
+    char tempStackMarker;
+    deepestStackMarker = (uintptr_t)&tempStackMarker;
+}
+
+int getEmulatorNativeStackFree(void) {
+    return EMULATOR_STACK_SIZE - (long)(stackBase - deepestStackMarker);
+}
+
+unsigned short getEmulatorTimerCount(void) {
+    return (unsigned long long)clock() * (8000000 / 64) / CLOCKS_PER_SEC;
+}
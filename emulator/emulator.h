@@ -0,0 +1,82 @@
+
+// Host replacements for the AVR headers used by main.c.
+// main.c includes this file instead of <avr/io.h>, <util/delay.h>
+// and <avr/pgmspace.h> when it is compiled with IS_EMULATOR.
+// Only plain C types are used here because main.c redefines
+// the fixed-width integer names as macros.
+
+#ifndef EMULATOR_H
+#define EMULATOR_H
+
+#include <stdlib.h>
+
+#define PROGMEM
+#define pgm_read_byte(address) (*(const unsigned char *)(address))
+#define pgm_read_ptr(address) (*(void * const *)(address))
+
+#define _delay_ms(amount)
+#define _delay_us(amount)
+
+// Pin and SPI registers are written by the hardware setup in main.
+// Nothing reads them back on the host.
+extern unsigned char DDRB;
+extern unsigned char PORTB;
+extern unsigned char DDRC;
+extern unsigned char PORTC;
+extern unsigned char DDRD;
+extern unsigned char PORTD;
+extern unsigned char PIND;
+extern unsigned char SPCR;
+extern unsigned char SPSR;
+extern unsigned char SPDR;
+extern unsigned char TCCR1B;
+
+// Timer 1 counts host time in units of 64 cycles at 8 MHz.
+#define TCNT1 getEmulatorTimerCount()
+
+#define DDB1 1
+#define DDB2 2
+#define DDB3 3
+#define DDB4 4
+#define DDB5 5
+#define PORTB1 1
+#define DDC4 4
+#define DDC5 5
+#define PORTC4 4
+#define PORTC5 5
+#define SPE 6
+#define MSTR 4
+#define SPI2X 0
+#define SPIF 7
+#define CS10 0
+#define CS11 1
+
+char *itoa(int value, char *destination, int radix);
+char *ltoa(long value, char *destination, int radix);
+char *ultoa(unsigned long value, char *destination, int radix);
+char *dtostrf(double value, signed char width, unsigned char precision, char *destination);
+
+// Set by printText so that the emulator can log everything the
+// interpreter shows to the user.
+extern char *testOutput;
+
+void initializeEmulator(int argc, char **argv);
+void setEmulatorStorageChipSelect(int isSelected);
+unsigned char transferEmulatorSpiInt8(unsigned char value);
+void sendEmulatorDisplayCommand(unsigned char data);
+void sendEmulatorDisplayCharacter(unsigned char data);
+char getEmulatorPressedKey(void);
+char emulatorEscapeKeyIsPressed(void);
+char emulatorNativeStackHasCollision(int offset);
+void paintEmulatorNativeStack(void);
+int getEmulatorNativeStackFree(void);
+unsigned short getEmulatorTimerCount(void);
+
+// Implemented in main.c for the emulator.
+void initializeEmulatorStorage(void);
+const char *getEmulatorSymbolText(unsigned char symbol);
+char importEmulatorFile(char *name, char *text);
+char runEmulatorFile(char *name);
+
+#endif
+
@@ -1,7 +1,11 @@
 
-#include <avr/io.h>
-#include <util/delay.h>
-#include <avr/pgmspace.h>
+#ifdef IS_EMULATOR
+    #include "emulator/emulator.h"
+#else
+    #include <avr/io.h>
+    #include <util/delay.h>
+    #include <avr/pgmspace.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -24,8 +28,13 @@
 #define MOSI_PIN_OUTPUT   DDRB |= (1 << DDB3)
 
 #define EEPROM_CS_PIN_OUTPUT   DDRB |= (1 << DDB1)
-#define EEPROM_CS_PIN_HIGH   PORTB |= (1 << PORTB1)
-#define EEPROM_CS_PIN_LOW   PORTB &= ~(1 << PORTB1)
+#ifdef IS_EMULATOR
+    #define EEPROM_CS_PIN_HIGH   setEmulatorStorageChipSelect(false)
+    #define EEPROM_CS_PIN_LOW   setEmulatorStorageChipSelect(true)
+#else
+    #define EEPROM_CS_PIN_HIGH   PORTB |= (1 << PORTB1)
+    #define EEPROM_CS_PIN_LOW   PORTB &= ~(1 << PORTB1)
+#endif
 
 #define DISPLAY_CLOCK_PIN_OUTPUT   DDRC |= (1 << DDC4)
 #define DISPLAY_CLOCK_PIN_HIGH   PORTC |= (1 << PORTC4)
@@ -50,6 +59,57 @@
 #define SYMBOL_SET_NAME_WIDTH 5
 
 #define STORAGE_SIZE ((int32_t)256 * (int32_t)128)
+#define STORAGE_PAGE_SIZE 64
+
+// Number of EEPROM pages which readStorage keeps in SRAM.
+// Each page costs STORAGE_PAGE_SIZE + 4 bytes. Zero disables the cache.
+// This and the caches below are left out of device builds by default,
+// because the firmware has little flash and SRAM to spare. Run
+// "make size" after enabling one to check that the firmware still fits.
+#ifndef STORAGE_CACHE_PAGE_AMOUNT
+    #ifdef IS_EMULATOR
+        #define STORAGE_CACHE_PAGE_AMOUNT 2
+    #else
+        #define STORAGE_CACHE_PAGE_AMOUNT 0
+    #endif
+#endif
+
+// Number of page writes which writeStorage can queue before it
+// has to wait for the EEPROM. Each costs STORAGE_PAGE_SIZE + 3 bytes.
+#ifndef STORAGE_WRITE_QUEUE_PAGE_AMOUNT
+    #define STORAGE_WRITE_QUEUE_PAGE_AMOUNT 1
+#endif
+
+// Number of parsed number literals which evaluateLiteralExpression
+// remembers by code address. Each costs 10 bytes. Zero disables it.
+#ifndef NUMBER_LITERAL_CACHE_SIZE
+    #ifdef IS_EMULATOR
+        #define NUMBER_LITERAL_CACHE_SIZE 8
+    #else
+        #define NUMBER_LITERAL_CACHE_SIZE 0
+    #endif
+#endif
+
+// Number of block clauses (if:, elif:, else:, while: and func: lines)
+// whose next clause at the same depth is remembered, so that ignored
+// blocks can be jumped over. Each costs 8 bytes. Zero disables it.
+#ifndef BLOCK_CLAUSE_CACHE_SIZE
+    #ifdef IS_EMULATOR
+        #define BLOCK_CLAUSE_CACHE_SIZE 8
+    #else
+        #define BLOCK_CLAUSE_CACHE_SIZE 0
+    #endif
+#endif
+
+// Number of variable references whose resolved value is remembered
+// by code address. Each costs 9 bytes. Zero disables it.
+#ifndef VARIABLE_CACHE_SIZE
+    #ifdef IS_EMULATOR
+        #define VARIABLE_CACHE_SIZE 8
+    #else
+        #define VARIABLE_CACHE_SIZE 0
+    #endif
+#endif
 
 #define KEY_CURSOR_LEFT 0
 #define KEY_CURSOR_RIGHT 1
@@ -89,28 +149,81 @@
 #define VALUE_TYPE_STRING 2
 #define VALUE_TYPE_LIST 3
 #define VALUE_TYPE_FUNCTION 4
+// Read-only string backed by a file in storage. The data holds the
+// index of the file and the generation of that index. print:, + and
+// the file writers copy the text into a string first.
+#define VALUE_TYPE_VIEW 5
+// Whole number held as int32_t. Scripts see it as a number, and it
+// turns into VALUE_TYPE_NUMBER when a result has a fraction or does
+// not fit.
+#define VALUE_TYPE_INTEGER 6
 
 #define FILE_NAME_MAXIMUM_LENGTH 15
+// Largest file which the text editor can hold in memory.
 #define FILE_MAXIMUM_SIZE 1000
 #define FILE_EXISTS_TRUE 1
 #define FILE_EXISTS_FALSE 255
 
-#define FILE_ENTRY_SIZE 1024
+// Files are addressed from FILE_VIRTUAL_ADDRESS upward, FILE_ENTRY_SIZE
+// bytes per file. readStorage and writeStorage translate these
+// addresses: the first FILE_DATA_OFFSET bytes of a file map to its
+// directory entry and the rest map to its text.
+#define FILE_VIRTUAL_ADDRESS STORAGE_SIZE
+#define FILE_ENTRY_SIZE STORAGE_SIZE
 #define FILE_EXISTS_OFFSET 0
 #define FILE_NAME_OFFSET (FILE_EXISTS_OFFSET + 1)
 #define FILE_SIZE_OFFSET (FILE_NAME_OFFSET + FILE_NAME_MAXIMUM_LENGTH + 1)
 #define FILE_DATA_OFFSET (FILE_SIZE_OFFSET + 2)
 
+// File text is stored in a chain of FILE_UNIT_SIZE units. Byte N of
+// a file lives at offset N % FILE_UNIT_SIZE of unit N / FILE_UNIT_SIZE
+// in the chain, so the first FILE_DATA_OFFSET bytes of the first unit
+// are unused and text keeps the page alignment of its file address.
+#define FILE_UNIT_SIZE 128
+#define FILE_UNIT_AMOUNT (STORAGE_SIZE / FILE_UNIT_SIZE)
+#define FILE_UNIT_RESERVED 0xFD
+#define FILE_UNIT_END 0xFE
+#define FILE_UNIT_FREE 0xFF
+
+// Older versions stored each file in its own FILE_SLOT_SIZE slot.
+#define FILE_SLOT_SIZE 1024
+
+// The directory fills the last DIRECTORY_SIZE bytes of the EEPROM.
+// It begins with a signature and version, followed by one entry per
+// file. Each entry holds the same fields as the start of a file,
+// then the name hash and the EEPROM address of the first unit. The
+// directory ends with the allocation table, which holds the next
+// unit of each unit in a chain or one of the FILE_UNIT_ values.
+#define DIRECTORY_SIZE 1024
+#define DIRECTORY_ADDRESS (STORAGE_SIZE - DIRECTORY_SIZE)
+#define DIRECTORY_SIGNATURE 0xC5D1
+#define DIRECTORY_VERSION 2
+// Marks a conversion which stopped after copying the file in the last
+// slot. The low byte holds the number of copied units.
+#define DIRECTORY_VERSION_CONVERTING 0x8000
+#define DIRECTORY_SIGNATURE_OFFSET 0
+#define DIRECTORY_VERSION_OFFSET (DIRECTORY_SIGNATURE_OFFSET + 2)
+#define DIRECTORY_ENTRY_OFFSET (DIRECTORY_VERSION_OFFSET + 2)
+#define DIRECTORY_ENTRY_HASH_OFFSET FILE_DATA_OFFSET
+#define DIRECTORY_ENTRY_START_OFFSET (DIRECTORY_ENTRY_HASH_OFFSET + 1)
+#define DIRECTORY_ENTRY_SIZE (DIRECTORY_ENTRY_START_OFFSET + 2)
+#define DIRECTORY_TABLE_OFFSET (DIRECTORY_SIZE - FILE_UNIT_AMOUNT)
+#define FILE_AMOUNT 32
+
 #define DESTINATION_TYPE_VALUE 0
 #define DESTINATION_TYPE_SYMBOL 1
+#define DESTINATION_TYPE_READ_ONLY 2
 
 #define EVALUATION_STATUS_NORMAL 0
 #define EVALUATION_STATUS_QUIT 1
 #define EVALUATION_STATUS_RETURN 2
 
+// Variables of a scope are kept in SCOPE_BUCKET_AMOUNT lists chosen
+// by name hash. Must be a power of two.
+#define SCOPE_BUCKET_AMOUNT 4
 #define SCOPE_SIZE_OFFSET 0
 #define SCOPE_VARIABLE_OFFSET (SCOPE_SIZE_OFFSET + 2)
-#define SCOPE_BRANCH_OFFSET (SCOPE_VARIABLE_OFFSET + sizeof(int8_t *))
+#define SCOPE_BRANCH_OFFSET (SCOPE_VARIABLE_OFFSET + SCOPE_BUCKET_AMOUNT * sizeof(int8_t *))
 #define SCOPE_DATA_OFFSET (SCOPE_BRANCH_OFFSET + sizeof(int8_t *))
 
 #define NUMBER_LITERAL_MAXIMUM_LENGTH 20
@@ -118,7 +231,8 @@
 
 #define VARIABLE_NEXT_OFFSET 0
 #define VARIABLE_VALUE_OFFSET (VARIABLE_NEXT_OFFSET + sizeof(int8_t *))
-#define VARIABLE_NAME_OFFSET (VARIABLE_VALUE_OFFSET + sizeof(value_t))
+#define VARIABLE_HASH_OFFSET (VARIABLE_VALUE_OFFSET + sizeof(value_t))
+#define VARIABLE_NAME_OFFSET (VARIABLE_HASH_OFFSET + 1)
 
 #define BRANCH_ACTION_RUN 0
 #define BRANCH_ACTION_IGNORE_SOFT 1
@@ -135,6 +249,22 @@
 #define MENU_RESULT_ESCAPE -1
 #define MENU_RESULT_ERROR -2
 
+#define PROFILE_FILE_NAME "PROFILE"
+#define PROFILE_ENTRY_AMOUNT 8
+
+#define FILE_HANDLE_AMOUNT 4
+#define FILE_LINE_SCAN_SIZE 16
+#define FILE_VIEW_COMPARE_SIZE 16
+// fReadNum: and fWriteNum: store numbers as raw floats.
+#define FILE_NUMBER_SIZE 4
+#define FILE_NUMBER_BUFFER_AMOUNT 8
+
+#define BENCHMARK_FILE_NAME "BENCH"
+#define BENCHMARK_MARKER_START 1
+#define BENCHMARK_MARKER_END 2
+#define BENCHMARK_MARKER_ERROR 3
+#define BENCHMARK_MARKER_MISSING_FILE 4
+
 const int8_t SYMBOL_TEXT_BOOLEAN_AND[] PROGMEM = "&&";
 const int8_t SYMBOL_TEXT_BOOLEAN_OR[] PROGMEM = "||";
 const int8_t SYMBOL_TEXT_BOOLEAN_XOR[] PROGMEM = "^^";
@@ -210,6 +340,18 @@ const int8_t SYMBOL_TEXT_FILE_SET_NAME[] PROGMEM = "fSetName:";
 const int8_t SYMBOL_TEXT_FILE_READ[] PROGMEM = "fRead:";
 const int8_t SYMBOL_TEXT_FILE_WRITE[] PROGMEM = "fWrite:";
 const int8_t SYMBOL_TEXT_FILE_IMPORT[] PROGMEM = "fImport:";
+const int8_t SYMBOL_TEXT_STORAGE_STATISTICS[] PROGMEM = "fStats;";
+const int8_t SYMBOL_TEXT_MEMORY_STATISTICS[] PROGMEM = "memStats;";
+const int8_t SYMBOL_TEXT_FILE_OPEN[] PROGMEM = "fOpen:";
+const int8_t SYMBOL_TEXT_FILE_CLOSE[] PROGMEM = "fClose:";
+const int8_t SYMBOL_TEXT_FILE_APPEND[] PROGMEM = "fAppend:";
+const int8_t SYMBOL_TEXT_FILE_WRITE_AT[] PROGMEM = "fWriteAt:";
+const int8_t SYMBOL_TEXT_FILE_READ_LINE[] PROGMEM = "fReadLine:";
+const int8_t SYMBOL_TEXT_FILE_COPY[] PROGMEM = "fCopy:";
+const int8_t SYMBOL_TEXT_FILE_LIST[] PROGMEM = "fList:";
+const int8_t SYMBOL_TEXT_FILE_VIEW[] PROGMEM = "fView:";
+const int8_t SYMBOL_TEXT_FILE_READ_NUMBER[] PROGMEM = "fReadNum:";
+const int8_t SYMBOL_TEXT_FILE_WRITE_NUMBER[] PROGMEM = "fWriteNum:";
 
 const int8_t * const SYMBOL_TEXT_LIST[] PROGMEM = {
     SYMBOL_TEXT_BOOLEAN_AND,
@@ -281,7 +423,19 @@ const int8_t * const SYMBOL_TEXT_LIST[] PROGMEM = {
     SYMBOL_TEXT_FILE_SET_NAME,
     SYMBOL_TEXT_FILE_READ,
     SYMBOL_TEXT_FILE_WRITE,
-    SYMBOL_TEXT_FILE_IMPORT
+    SYMBOL_TEXT_FILE_IMPORT,
+    SYMBOL_TEXT_STORAGE_STATISTICS,
+    SYMBOL_TEXT_MEMORY_STATISTICS,
+    SYMBOL_TEXT_FILE_OPEN,
+    SYMBOL_TEXT_FILE_CLOSE,
+    SYMBOL_TEXT_FILE_APPEND,
+    SYMBOL_TEXT_FILE_WRITE_AT,
+    SYMBOL_TEXT_FILE_READ_LINE,
+    SYMBOL_TEXT_FILE_COPY,
+    SYMBOL_TEXT_FILE_LIST,
+    SYMBOL_TEXT_FILE_VIEW,
+    SYMBOL_TEXT_FILE_READ_NUMBER,
+    SYMBOL_TEXT_FILE_WRITE_NUMBER
 };
 
 #define SYMBOL_BOOLEAN_AND 128
@@ -354,6 +508,18 @@ const int8_t * const SYMBOL_TEXT_LIST[] PROGMEM = {
 #define SYMBOL_FILE_READ 195
 #define SYMBOL_FILE_WRITE 196
 #define SYMBOL_FILE_IMPORT 197
+#define SYMBOL_STORAGE_STATISTICS 198
+#define SYMBOL_MEMORY_STATISTICS 199
+#define SYMBOL_FILE_OPEN 200
+#define SYMBOL_FILE_CLOSE 201
+#define SYMBOL_FILE_APPEND 202
+#define SYMBOL_FILE_WRITE_AT 203
+#define SYMBOL_FILE_READ_LINE 204
+#define SYMBOL_FILE_COPY 205
+#define SYMBOL_FILE_LIST 206
+#define SYMBOL_FILE_VIEW 207
+#define SYMBOL_FILE_READ_NUMBER 208
+#define SYMBOL_FILE_WRITE_NUMBER 209
 
 const int8_t UNARY_OPERATOR_LIST[] PROGMEM = {
     '-',
@@ -437,8 +603,25 @@ const int8_t BINARY_OPERATOR_PRECEDENCE_LIST[] PROGMEM = {
     12 // SYMBOL_BITSHIFT_RIGHT_ASSIGN
 };
 
+// Operator applied by each compound assignment.
+const uint8_t ASSIGNMENT_OPERATOR_LIST[] PROGMEM = {
+    '+', // SYMBOL_ADD_ASSIGN
+    '-', // SYMBOL_SUBTRACT_ASSIGN
+    '*', // SYMBOL_MULTIPLY_ASSIGN
+    '/', // SYMBOL_DIVIDE_ASSIGN
+    '%', // SYMBOL_MODULUS_ASSIGN
+    SYMBOL_BOOLEAN_AND, // SYMBOL_BOOLEAN_AND_ASSIGN
+    SYMBOL_BOOLEAN_OR, // SYMBOL_BOOLEAN_OR_ASSIGN
+    SYMBOL_BOOLEAN_XOR, // SYMBOL_BOOLEAN_XOR_ASSIGN
+    '&', // SYMBOL_BITWISE_AND_ASSIGN
+    '|', // SYMBOL_BITWISE_OR_ASSIGN
+    '^', // SYMBOL_BITWISE_XOR_ASSIGN
+    SYMBOL_BITSHIFT_LEFT, // SYMBOL_BITSHIFT_LEFT_ASSIGN
+    SYMBOL_BITSHIFT_RIGHT // SYMBOL_BITSHIFT_RIGHT_ASSIGN
+};
+
 #define FIRST_FUNCTION_SYMBOL SYMBOL_IF
-#define LAST_FUNCTION_SYMBOL SYMBOL_FILE_IMPORT
+#define LAST_FUNCTION_SYMBOL SYMBOL_FILE_WRITE_NUMBER
 
 const int8_t FUNCTION_ARGUMENT_AMOUNT_LIST[] PROGMEM = {
     1, // SYMBOL_IF
@@ -486,7 +669,19 @@ const int8_t FUNCTION_ARGUMENT_AMOUNT_LIST[] PROGMEM = {
     2, // SYMBOL_FILE_SET_NAME
     3, // SYMBOL_FILE_READ
     2, // SYMBOL_FILE_WRITE
-    1 // SYMBOL_FILE_IMPORT
+    1, // SYMBOL_FILE_IMPORT
+    0, // SYMBOL_STORAGE_STATISTICS
+    0, // SYMBOL_MEMORY_STATISTICS
+    1, // SYMBOL_FILE_OPEN
+    1, // SYMBOL_FILE_CLOSE
+    2, // SYMBOL_FILE_APPEND
+    3, // SYMBOL_FILE_WRITE_AT
+    1, // SYMBOL_FILE_READ_LINE
+    2, // SYMBOL_FILE_COPY
+    1, // SYMBOL_FILE_LIST
+    1, // SYMBOL_FILE_VIEW
+    2, // SYMBOL_FILE_READ_NUMBER
+    3 // SYMBOL_FILE_WRITE_NUMBER
 };
 
 const uint8_t SYMBOL_SET_LETTERS[] PROGMEM = {
@@ -593,7 +788,19 @@ const uint8_t SYMBOL_SET_INPUT_OUTPUT[] PROGMEM = {
     SYMBOL_FILE_SET_NAME,
     SYMBOL_FILE_READ,
     SYMBOL_FILE_WRITE,
-    SYMBOL_FILE_IMPORT
+    SYMBOL_FILE_IMPORT,
+    SYMBOL_STORAGE_STATISTICS,
+    SYMBOL_MEMORY_STATISTICS,
+    SYMBOL_FILE_OPEN,
+    SYMBOL_FILE_CLOSE,
+    SYMBOL_FILE_APPEND,
+    SYMBOL_FILE_WRITE_AT,
+    SYMBOL_FILE_READ_LINE,
+    SYMBOL_FILE_COPY,
+    SYMBOL_FILE_LIST,
+    SYMBOL_FILE_VIEW,
+    SYMBOL_FILE_READ_NUMBER,
+    SYMBOL_FILE_WRITE_NUMBER
 };
 
 const uint8_t SYMBOL_SET_VALUE[] PROGMEM = {
@@ -674,13 +881,18 @@ const int8_t MENU_OPTION_QUIT[] PROGMEM = "Quit";
 const int8_t MENU_OPTION_YES_DELETE[] PROGMEM = "Yes delete";
 const int8_t MENU_OPTION_NO_DELETE[] PROGMEM = "Do not delete";
 const int8_t MENU_OPTION_GET_SIZE[] PROGMEM = "Get size";
+const int8_t MENU_OPTION_DIAGNOSTICS[] PROGMEM = "Diagnostics";
+const int8_t MENU_OPTION_PROFILE[] PROGMEM = "Profile";
+const int8_t MENU_OPTION_COPY[] PROGMEM = "Copy";
 
 const int8_t * const MENU_FILE[] PROGMEM = {
     MENU_OPTION_RUN,
     MENU_OPTION_EDIT,
     MENU_OPTION_GET_SIZE,
     MENU_OPTION_RENAME,
-    MENU_OPTION_DELETE
+    MENU_OPTION_DELETE,
+    MENU_OPTION_PROFILE,
+    MENU_OPTION_COPY
 };
 
 const int8_t * const MENU_TEXT_EDITOR[] PROGMEM = {
@@ -699,11 +911,75 @@ const int8_t MESSAGE_FILE_CREATED[] PROGMEM = "Created file.";
 const int8_t MESSAGE_ENTER_NEW_NAME[] PROGMEM = "Enter new name.";
 const int8_t MESSAGE_FILE_RENAMED[] PROGMEM = "Renamed file.";
 const int8_t MESSAGE_FILE_DELETED[] PROGMEM = "Deleted file.";
+const int8_t MESSAGE_FILE_COPIED[] PROGMEM = "Copied file.";
 const int8_t MESSAGE_SAVING[] PROGMEM = "Saving...";
 const int8_t MESSAGE_FILE_SAVED[] PROGMEM = "Saved file.";
 const int8_t MESSAGE_RUNNING[] PROGMEM = "Running...";
+const int8_t MESSAGE_PROFILE_SAVED[] PROGMEM = "Saved profile.";
+const int8_t MESSAGE_PROFILE_OTHER[] PROGMEM = "Other ";
 const int8_t MESSAGE_WELCOME[] PROGMEM = "ChipOS\nVersion 1.0";
 
+#define STORAGE_STATISTIC_READ_BYTES 0
+#define STORAGE_STATISTIC_WRITTEN_BYTES 1
+#define STORAGE_STATISTIC_READ_RESTARTS 2
+#define STORAGE_STATISTIC_PAGE_PROGRAMS 3
+#define STORAGE_STATISTIC_CACHE_MISSES 4
+#define STORAGE_STATISTIC_AMOUNT 5
+
+const int8_t STORAGE_STATISTIC_NAME_READ_BYTES[] PROGMEM = "Read ";
+const int8_t STORAGE_STATISTIC_NAME_WRITTEN_BYTES[] PROGMEM = "Write ";
+const int8_t STORAGE_STATISTIC_NAME_READ_RESTARTS[] PROGMEM = "Select ";
+const int8_t STORAGE_STATISTIC_NAME_PAGE_PROGRAMS[] PROGMEM = "Page ";
+const int8_t STORAGE_STATISTIC_NAME_CACHE_MISSES[] PROGMEM = "Miss ";
+
+const int8_t * const STORAGE_STATISTIC_NAME_LIST[] PROGMEM = {
+    STORAGE_STATISTIC_NAME_READ_BYTES,
+    STORAGE_STATISTIC_NAME_WRITTEN_BYTES,
+    STORAGE_STATISTIC_NAME_READ_RESTARTS,
+    STORAGE_STATISTIC_NAME_PAGE_PROGRAMS,
+    STORAGE_STATISTIC_NAME_CACHE_MISSES
+};
+
+// Heap and stack boundaries are offsets into memory.
+// Collection times are in CPU cycles.
+#define MEMORY_STATISTIC_LOWEST_HEAP 0
+#define MEMORY_STATISTIC_HIGHEST_STACK 1
+#define MEMORY_STATISTIC_COLLECTIONS 2
+#define MEMORY_STATISTIC_COLLECTION_CYCLES 3
+#define MEMORY_STATISTIC_LONGEST_COLLECTION 4
+#define MEMORY_STATISTIC_FAILED_SIZE 5
+#define MEMORY_STATISTIC_LARGEST_GAP 6
+#define MEMORY_STATISTIC_NATIVE_STACK_FREE 7
+#define MEMORY_STATISTIC_AMOUNT 8
+
+const int8_t MEMORY_STATISTIC_NAME_LOWEST_HEAP[] PROGMEM = "Heap ";
+const int8_t MEMORY_STATISTIC_NAME_HIGHEST_STACK[] PROGMEM = "Stack ";
+const int8_t MEMORY_STATISTIC_NAME_COLLECTIONS[] PROGMEM = "GC ";
+const int8_t MEMORY_STATISTIC_NAME_COLLECTION_CYCLES[] PROGMEM = "GC total ";
+const int8_t MEMORY_STATISTIC_NAME_LONGEST_COLLECTION[] PROGMEM = "GC max ";
+const int8_t MEMORY_STATISTIC_NAME_FAILED_SIZE[] PROGMEM = "Failed ";
+const int8_t MEMORY_STATISTIC_NAME_LARGEST_GAP[] PROGMEM = "Gap ";
+const int8_t MEMORY_STATISTIC_NAME_NATIVE_STACK_FREE[] PROGMEM = "Native ";
+
+const int8_t * const MEMORY_STATISTIC_NAME_LIST[] PROGMEM = {
+    MEMORY_STATISTIC_NAME_LOWEST_HEAP,
+    MEMORY_STATISTIC_NAME_HIGHEST_STACK,
+    MEMORY_STATISTIC_NAME_COLLECTIONS,
+    MEMORY_STATISTIC_NAME_COLLECTION_CYCLES,
+    MEMORY_STATISTIC_NAME_LONGEST_COLLECTION,
+    MEMORY_STATISTIC_NAME_FAILED_SIZE,
+    MEMORY_STATISTIC_NAME_LARGEST_GAP,
+    MEMORY_STATISTIC_NAME_NATIVE_STACK_FREE
+};
+
+// Unused native stack is filled with this byte so that
+// getNativeStackFree can find how deep the stack has been.
+#define NATIVE_STACK_PAINT 0xC5
+#define NATIVE_STACK_PAINT_MARGIN 32
+
+// Timer 1 counts CPU cycles divided by this amount.
+#define MEMORY_TIMER_PRESCALER 64
+
 const int8_t ERROR_MESSAGE_BAD_START_OF_EXPRESSION[] PROGMEM = "ERROR: Bad\nstart of\nexpression.";
 const int8_t ERROR_MESSAGE_BAD_END_STATEMENT[] PROGMEM = "ERROR: Bad\nend statement.";
 const int8_t ERROR_MESSAGE_BAD_CONTINUE_STATEMENT[] PROGMEM = "ERROR: Bad\ncontinue\nstatement.";
@@ -721,6 +997,10 @@ const int8_t ERROR_MESSAGE_NAME_IS_TOO_LONG[] PROGMEM = "ERROR: Name is\ntoo lon
 const int8_t ERROR_MESSAGE_STORAGE_IS_FULL[] PROGMEM = "ERROR: Storage\nis full.";
 const int8_t ERROR_MESSAGE_BAD_AMOUNT[] PROGMEM = "ERROR: Bad\namount.";
 const int8_t ERROR_MESSAGE_FILE_EXISTS[] PROGMEM = "ERROR: File\nexists.";
+const int8_t ERROR_MESSAGE_FILE_IS_TOO_LARGE[] PROGMEM = "ERROR: File is\ntoo large.";
+const int8_t ERROR_MESSAGE_CANNOT_CONVERT_STORAGE[] PROGMEM = "ERROR: Storage\nis full. Delete\na file with the\nold firmware.";
+const int8_t ERROR_MESSAGE_BAD_HANDLE[] PROGMEM = "ERROR: Bad\nhandle.";
+const int8_t ERROR_MESSAGE_TOO_MANY_OPEN_FILES[] PROGMEM = "ERROR: Too many\nopen files.";
 const int8_t ERROR_MESSAGE_BAD_DESTINATION[] PROGMEM = "ERROR: Bad\ndestination.";
 const int8_t ERROR_MESSAGE_BAD_OPERAND_TYPE[] PROGMEM = "ERROR: Bad\noperand type.";
 const int8_t ERROR_MESSAGE_DIVIDE_BY_ZERO[] PROGMEM = "ERROR: Divide\nby zero.";
@@ -766,6 +1046,39 @@ typedef struct treasureTracker {
     void *treasure;
 } treasureTracker_t;
 
+// Count includes error, which was inherited from evicted entries.
+typedef struct profileEntry {
+    int32_t address;
+    uint16_t count;
+    uint16_t error;
+} profileEntry_t;
+
+// Counts how many statements runCode started at each code address.
+// Lines skipped by if: and while: are counted too because skipping
+// them still costs time. When entryList is full, a new address
+// replaces the entry with the lowest count and inherits that count
+// as its error, so busy lines are kept however late they start.
+// otherCount holds the counts of the evicted addresses.
+
+typedef struct profile {
+    uint16_t otherCount;
+    int8_t entryAmount;
+    profileEntry_t entryList[PROFILE_ENTRY_AMOUNT];
+} profile_t;
+
+// A file opened by fOpen:. Address is 0 when the handle is free.
+typedef struct fileHandle {
+    int32_t address;
+    int16_t size;
+    int16_t cursor;
+} fileHandle_t;
+
+// The files shown by the file list menu.
+typedef struct fileList {
+    int8_t indexList[FILE_AMOUNT];
+    int8_t amount;
+} fileList_t;
+
 typedef struct expressionStatus {
     expressionResult_t result;
     treasureTracker_t treasureTracker;
@@ -794,19 +1107,123 @@ int16_t commandsSinceMarkAndSweep = 0;
 int16_t allocationsSinceMarkAndSweep = 0;
 const int8_t *errorMessage = NULL;
 int32_t errorCode;
+// Only set while a file runs from the "Profile" menu option.
+profile_t *profile = NULL;
 
 int32_t storageAddress = -100;
 int8_t lastStorageData;
+// Counts EEPROM traffic during the last runFile. See STORAGE_STATISTIC_*.
+uint32_t storageStatistics[STORAGE_STATISTIC_AMOUNT];
+int16_t storageWriteQueueAddressList[STORAGE_WRITE_QUEUE_PAGE_AMOUNT];
+uint8_t storageWriteQueueAmountList[STORAGE_WRITE_QUEUE_PAGE_AMOUNT];
+// Data is stored at its offset within the page.
+uint8_t storageWriteQueueData[STORAGE_WRITE_QUEUE_PAGE_AMOUNT][STORAGE_PAGE_SIZE];
+// The queue is a ring buffer which starts at this index.
+int8_t storageWriteQueueStart = 0;
+int8_t storageWriteQueueLength = 0;
+int8_t storageIsWriting = false;
+#if STORAGE_CACHE_PAGE_AMOUNT > 0
+// Page numbers are stored plus one so that zero means empty.
+uint16_t storageCachePageList[STORAGE_CACHE_PAGE_AMOUNT];
+uint16_t storageCacheUseList[STORAGE_CACHE_PAGE_AMOUNT];
+uint16_t storageCacheClock = 0;
+uint16_t storageCacheCandidatePage = 0;
+uint8_t storageCacheData[STORAGE_CACHE_PAGE_AMOUNT][STORAGE_PAGE_SIZE];
+#endif
+#if NUMBER_LITERAL_CACHE_SIZE > 0
+// Code addresses of cached literals. Zero means empty, because code
+// always lives at a file address.
+int32_t numberLiteralCacheAddressList[NUMBER_LITERAL_CACHE_SIZE];
+value_t numberLiteralCacheValueList[NUMBER_LITERAL_CACHE_SIZE];
+int8_t numberLiteralCacheLengthList[NUMBER_LITERAL_CACHE_SIZE];
+#endif
+#if BLOCK_CLAUSE_CACHE_SIZE > 0
+// Code addresses of clauses and of the elif:, else: or end; which
+// follows each one. Zero means empty.
+int32_t blockClauseCacheStartList[BLOCK_CLAUSE_CACHE_SIZE];
+int32_t blockClauseCacheEndList[BLOCK_CLAUSE_CACHE_SIZE];
+#endif
+#if VARIABLE_CACHE_SIZE > 0
+// An entry is only valid in the scope which resolved it. Every entry
+// into a function gives the new scope a new serial number, and so
+// does creating a variable, because it may hide a global.
+int32_t variableCacheAddressList[VARIABLE_CACHE_SIZE];
+value_t *variableCacheValueList[VARIABLE_CACHE_SIZE];
+int8_t variableCacheLengthList[VARIABLE_CACHE_SIZE];
+uint16_t variableCacheScopeList[VARIABLE_CACHE_SIZE];
+uint16_t variableCacheScope = 0;
+uint16_t variableCacheLastScope = 0;
+// Counts wrap arounds of variableCacheLastScope. A caller's serial is
+// only restored if it has not been handed out again during the call.
+uint16_t variableCacheEpoch = 0;
+#endif
+// Describes memory use during the last runFile. See MEMORY_STATISTIC_*.
+// Failed size comes from the last allocation which did not fit. Largest
+// gap is the lowest largest free block seen after a collection or at a
+// failed allocation. A gap much smaller than memory - stack means
+// fragmentation.
+uint32_t memoryStatistics[MEMORY_STATISTIC_AMOUNT];
 int8_t repeatKey = -2;
+// Mirrors the directory so that finding a file only
+// reads the names of entries whose name hash matches.
+uint32_t fileExistsBitmap = 0;
+uint8_t fileNameHashList[FILE_AMOUNT];
+// Counts the deletions of each file so that a view of a deleted file
+// does not read a file created later at the same index.
+uint8_t fileGenerationList[FILE_AMOUNT];
+// Remembers the last unit found by translateFileAddress so that
+// reading through a file follows each link in its chain once.
+int8_t storageTranslationIndex = -1;
+uint8_t storageTranslationFirstUnit;
+uint8_t storageTranslationPosition;
+uint8_t storageTranslationUnit;
+fileHandle_t fileHandleList[FILE_HANDLE_AMOUNT];
 
 static void debugPrint(int16_t value);
+static void flushStorageWrites();
 
 static int8_t nativeStackHasCollision(int16_t offset) {
-    extern uint8_t _end;
-    return (int16_t)&_end >= (int16_t)(SP - offset);
+    #ifdef IS_EMULATOR
+        return emulatorNativeStackHasCollision(offset);
+    #else
+        extern uint8_t _end;
+        return (int16_t)&_end >= (int16_t)(SP - offset);
+    #endif
+}
+
+static void paintNativeStack() {
+    #ifdef IS_EMULATOR
+        paintEmulatorNativeStack();
+    #else
+        extern uint8_t _end;
+        uint8_t *tempAddress = &_end;
+        uint8_t *tempEndAddress = (uint8_t *)(SP - NATIVE_STACK_PAINT_MARGIN);
+        while (tempAddress < tempEndAddress) {
+            *tempAddress = NATIVE_STACK_PAINT;
+            tempAddress += 1;
+        }
+    #endif
+}
+
+// Returns the amount of native stack which has not been
+// used since the last call to paintNativeStack.
+static int32_t getNativeStackFree() {
+    #ifdef IS_EMULATOR
+        return getEmulatorNativeStackFree();
+    #else
+        extern uint8_t _end;
+        uint8_t *tempAddress = &_end;
+        while (*tempAddress == NATIVE_STACK_PAINT) {
+            tempAddress += 1;
+        }
+        return tempAddress - &_end;
+    #endif
 }
 
 static int8_t receiveSpiInt8() {
+    #ifdef IS_EMULATOR
+        return transferEmulatorSpiInt8(0xFF);
+    #endif
     SPDR = 0xFF;
     while (!(SPSR & (1 << SPIF))) {
     
@@ -815,6 +1232,10 @@ static int8_t receiveSpiInt8() {
 }
 
 static void sendSpiInt8(int8_t value) {
+    #ifdef IS_EMULATOR
+        transferEmulatorSpiInt8(value);
+        return;
+    #endif
     SPDR = value;
     while (!(SPSR & (1 << SPIF))) {
     
@@ -843,12 +1264,20 @@ static void sendDisplayCommandInt4(uint8_t data) {
 }
 
 static void sendDisplayCommand(uint8_t data) {
+    #ifdef IS_EMULATOR
+        sendEmulatorDisplayCommand(data);
+        return;
+    #endif
     DISPLAY_MODE_PIN_LOW;
     sendDisplayData(data);
     _delay_us(50);
 }
 
 static void sendDisplayCharacter(uint8_t data) {
+    #ifdef IS_EMULATOR
+        sendEmulatorDisplayCharacter(data);
+        return;
+    #endif
     DISPLAY_MODE_PIN_HIGH;
     sendDisplayData(data);
     _delay_us(50);
@@ -869,6 +1298,9 @@ static void displayCharacter(int8_t posX, int8_t posY, int8_t character) {
 }
 
 static int8_t getPressedKey() {
+    #ifdef IS_EMULATOR
+        return getEmulatorPressedKey();
+    #endif
     int8_t tempData;
     BUTTON_INPUT_PINS_MODE(0x01);
     _delay_us(10);
@@ -928,6 +1360,9 @@ static int8_t getPressedKey() {
 }
 
 static int8_t escapeKeyIsPressed() {
+    #ifdef IS_EMULATOR
+        return emulatorEscapeKeyIsPressed();
+    #endif
     BUTTON_INPUT_PINS_MODE(0x04);
     _delay_us(10);
     int8_t tempData = ~BUTTON_OUTPUT_PIN_READ;
@@ -939,6 +1374,12 @@ static int8_t escapeKeyIsPressed() {
 }
 
 static int8_t getKey() {
+    // Waiting for the user is a good time to finish writing.
+    flushStorageWrites();
+    #ifdef IS_BENCHMARK
+        // Benchmarks measure the interpreter, not the user.
+        return KEY_SELECT_OPTION;
+    #endif
     int8_t tempKey = getPressedKey();
     _delay_ms(5);
     int16_t tempDelay;
@@ -974,10 +1415,133 @@ static void sendAddressToStorage(int32_t address) {
     sendSpiInt8(address & 0x000000FF);
 }
 
-static void readStorage(void *destination, int32_t address, int32_t amount) {
-    if (amount <= 0) {
-        return;
+// Returns whether the EEPROM is still busy with a page program.
+static int8_t storageIsBusy() {
+    if (!storageIsWriting) {
+        return false;
+    }
+    EEPROM_CS_PIN_HIGH;
+    _delay_us(5);
+    EEPROM_CS_PIN_LOW;
+    // Read the status register. Bit 0 is "write in progress".
+    sendSpiInt8(0x05);
+    uint8_t tempStatus = receiveSpiInt8();
+    EEPROM_CS_PIN_HIGH;
+    storageAddress = -100;
+    storageIsWriting = tempStatus & 0x01;
+    return storageIsWriting;
+}
+
+static void waitForStorage() {
+    while (storageIsBusy()) {
+        
+    }
+}
+
+// Converts a position in the write queue to an index in the queue arrays.
+static int8_t getStorageWriteQueueIndex(int8_t position) {
+    int8_t output = storageWriteQueueStart + position;
+    if (output >= STORAGE_WRITE_QUEUE_PAGE_AMOUNT) {
+        output -= STORAGE_WRITE_QUEUE_PAGE_AMOUNT;
+    }
+    return output;
+}
+
+// Starts programming the oldest queued page
+// and removes it from the queue.
+static void programNextStoragePage() {
+    waitForStorage();
+    EEPROM_CS_PIN_HIGH;
+    _delay_us(5);
+    EEPROM_CS_PIN_LOW;
+    sendSpiInt8(0x06);
+    EEPROM_CS_PIN_HIGH;
+    _delay_us(5);
+    EEPROM_CS_PIN_LOW;
+    sendSpiInt8(0x02);
+    int8_t tempIndex = storageWriteQueueStart;
+    int16_t tempAddress = storageWriteQueueAddressList[tempIndex];
+    uint8_t tempOffset = tempAddress % STORAGE_PAGE_SIZE;
+    sendAddressToStorage(tempAddress);
+    int8_t index = 0;
+    while (index < storageWriteQueueAmountList[tempIndex]) {
+        sendSpiInt8(storageWriteQueueData[tempIndex][tempOffset + index]);
+        index += 1;
+    }
+    EEPROM_CS_PIN_HIGH;
+    storageIsWriting = true;
+    storageAddress = -100;
+    storageStatistics[STORAGE_STATISTIC_PAGE_PROGRAMS] += 1;
+    storageWriteQueueStart = getStorageWriteQueueIndex(1);
+    storageWriteQueueLength -= 1;
+}
+
+// Starts the next page program if the EEPROM is idle. Called between
+// statements so that scripts keep running while the EEPROM writes.
+static void serviceStorageWrites() {
+    if (storageWriteQueueLength > 0 && !storageIsBusy()) {
+        programNextStoragePage();
+    }
+}
+
+static void flushStorageWrites() {
+    while (storageWriteQueueLength > 0) {
+        programNextStoragePage();
+    }
+    waitForStorage();
+}
+
+// Flushes the queue if any queued page overlaps the given range.
+static void flushStorageWritesInRange(int32_t address, int32_t amount) {
+    int32_t tempFirstPage = address / STORAGE_PAGE_SIZE;
+    int32_t tempLastPage = (address + amount - 1) / STORAGE_PAGE_SIZE;
+    int8_t index = 0;
+    while (index < storageWriteQueueLength) {
+        int32_t tempPage = storageWriteQueueAddressList[getStorageWriteQueueIndex(index)] / STORAGE_PAGE_SIZE;
+        if (tempPage >= tempFirstPage && tempPage <= tempLastPage) {
+            flushStorageWrites();
+            return;
+        }
+        index += 1;
+    }
+}
+
+// Queues a write which does not cross a page boundary. The write is
+// merged into the newest queued page when the two touch or overlap.
+static void queueStorageWrite(int32_t address, void *source, int8_t amount) {
+    uint8_t tempOffset = address % STORAGE_PAGE_SIZE;
+    if (storageWriteQueueLength > 0) {
+        int8_t tempIndex = getStorageWriteQueueIndex(storageWriteQueueLength - 1);
+        int16_t tempAddress = storageWriteQueueAddressList[tempIndex];
+        uint8_t tempAmount = storageWriteQueueAmountList[tempIndex];
+        if (tempAddress / STORAGE_PAGE_SIZE == address / STORAGE_PAGE_SIZE
+                && address <= tempAddress + tempAmount && address + amount >= tempAddress) {
+            memcpy(storageWriteQueueData[tempIndex] + tempOffset, source, amount);
+            int16_t tempEndAddress = tempAddress + tempAmount;
+            if (address + amount > tempEndAddress) {
+                tempEndAddress = address + amount;
+            }
+            if (address < tempAddress) {
+                tempAddress = address;
+            }
+            storageWriteQueueAddressList[tempIndex] = tempAddress;
+            storageWriteQueueAmountList[tempIndex] = tempEndAddress - tempAddress;
+            return;
+        }
     }
+    if (storageWriteQueueLength >= STORAGE_WRITE_QUEUE_PAGE_AMOUNT) {
+        programNextStoragePage();
+    }
+    int8_t tempIndex = getStorageWriteQueueIndex(storageWriteQueueLength);
+    storageWriteQueueAddressList[tempIndex] = address;
+    storageWriteQueueAmountList[tempIndex] = amount;
+    memcpy(storageWriteQueueData[tempIndex] + tempOffset, source, amount);
+    storageWriteQueueLength += 1;
+}
+
+static void readStorageFromSpi(void *destination, int32_t address, int32_t amount) {
+    flushStorageWritesInRange(address, amount);
+    waitForStorage();
     int32_t index = 0;
     if (address == storageAddress - 1) {
         *(int8_t *)(destination + index) = lastStorageData;
@@ -989,7 +1553,9 @@ static void readStorage(void *destination, int32_t address, int32_t amount) {
         sendSpiInt8(0x03);
         sendAddressToStorage(address);
         storageAddress = address;
+        storageStatistics[STORAGE_STATISTIC_READ_RESTARTS] += 1;
     }
+    storageStatistics[STORAGE_STATISTIC_READ_BYTES] += amount;
     while (index < amount) {
         int8_t tempData = receiveSpiInt8();
         *(int8_t *)(destination + index) = tempData;
@@ -999,39 +1565,306 @@ static void readStorage(void *destination, int32_t address, int32_t amount) {
     }
 }
 
+#if STORAGE_CACHE_PAGE_AMOUNT > 0
+
+// Returns the cached copy of the given page, reading it from EEPROM
+// if necessary. A page is only cached when it misses twice in a row.
+// Otherwise this function returns NULL. This keeps scans over the
+// file slots from evicting the code which is running.
+static uint8_t *getStorageCachePage(uint16_t page) {
+    storageCacheClock += 1;
+    int8_t tempSlot = 0;
+    uint16_t tempLargestAge = 0;
+    int8_t index = 0;
+    while (index < STORAGE_CACHE_PAGE_AMOUNT) {
+        uint16_t tempPage = storageCachePageList[index];
+        if (tempPage == page + 1) {
+            storageCacheUseList[index] = storageCacheClock;
+            return storageCacheData[index];
+        }
+        if (tempPage == 0) {
+            tempSlot = index;
+            tempLargestAge = 0xFFFF;
+        } else {
+            uint16_t tempAge = storageCacheClock - storageCacheUseList[index];
+            if (tempAge > tempLargestAge) {
+                tempSlot = index;
+                tempLargestAge = tempAge;
+            }
+        }
+        index += 1;
+    }
+    storageStatistics[STORAGE_STATISTIC_CACHE_MISSES] += 1;
+    if (storageCacheCandidatePage != page + 1) {
+        storageCacheCandidatePage = page + 1;
+        return NULL;
+    }
+    readStorageFromSpi(storageCacheData[tempSlot], (int32_t)page * STORAGE_PAGE_SIZE, STORAGE_PAGE_SIZE);
+    storageCachePageList[tempSlot] = page + 1;
+    storageCacheUseList[tempSlot] = storageCacheClock;
+    return storageCacheData[tempSlot];
+}
+
+#endif
+
+static int32_t getDirectoryEntryAddress(int8_t index) {
+    return DIRECTORY_ADDRESS + DIRECTORY_ENTRY_OFFSET + (int32_t)index * DIRECTORY_ENTRY_SIZE;
+}
+
+static int32_t getAllocationTableAddress(uint8_t unit) {
+    return DIRECTORY_ADDRESS + DIRECTORY_TABLE_OFFSET + unit;
+}
+
+#if NUMBER_LITERAL_CACHE_SIZE > 0
+
+static int8_t getNumberLiteralCacheSlot(int32_t address) {
+    return (uint8_t)address % NUMBER_LITERAL_CACHE_SIZE;
+}
+
+// Drops cached literals which overlap written bytes, so that editing
+// or rewriting a file never runs stale numbers. A write right after
+// a literal counts too, because appended digits lengthen it.
+static void forgetNumberLiterals(int32_t address, int32_t amount) {
+    int8_t index = 0;
+    while (index < NUMBER_LITERAL_CACHE_SIZE) {
+        int32_t tempAddress = numberLiteralCacheAddressList[index];
+        if (tempAddress < address + amount && tempAddress + numberLiteralCacheLengthList[index] >= address) {
+            numberLiteralCacheAddressList[index] = 0;
+        }
+        index += 1;
+    }
+}
+
+#endif
+
+#if BLOCK_CLAUSE_CACHE_SIZE > 0
+
+static int8_t getBlockClauseCacheSlot(int32_t address) {
+    return (uint8_t)address % BLOCK_CLAUSE_CACHE_SIZE;
+}
+
+// Drops clauses whose lines overlap written bytes, because the
+// written code may have moved the next clause.
+static void forgetBlockClauses(int32_t address, int32_t amount) {
+    int8_t index = 0;
+    while (index < BLOCK_CLAUSE_CACHE_SIZE) {
+        if (blockClauseCacheStartList[index] < address + amount && blockClauseCacheEndList[index] >= address) {
+            blockClauseCacheStartList[index] = 0;
+        }
+        index += 1;
+    }
+}
+
+#endif
+
+#if VARIABLE_CACHE_SIZE > 0
+
+static int8_t getVariableCacheSlot(int32_t address) {
+    return (uint8_t)address % VARIABLE_CACHE_SIZE;
+}
+
+// Drops references which overlap written bytes or end right before
+// them, because appended letters lengthen the name.
+static void forgetVariableReferences(int32_t address, int32_t amount) {
+    int8_t index = 0;
+    while (index < VARIABLE_CACHE_SIZE) {
+        int32_t tempAddress = variableCacheAddressList[index];
+        if (tempAddress < address + amount && tempAddress + variableCacheLengthList[index] >= address) {
+            variableCacheAddressList[index] = 0;
+        }
+        index += 1;
+    }
+}
+
+#endif
+
+// Gives the local scope a new serial number, which drops the
+// variable references that it resolved so far.
+static void renewVariableCacheScope() {
+    #if VARIABLE_CACHE_SIZE > 0
+        variableCacheLastScope += 1;
+        if (variableCacheLastScope == 0) {
+            // Old entries could match again after wrapping around.
+            memset(variableCacheAddressList, 0, sizeof(variableCacheAddressList));
+            variableCacheEpoch += 1;
+        }
+        variableCacheScope = variableCacheLastScope;
+    #endif
+}
+
+// Drops everything remembered by code address, because a file
+// created at the index of a deleted file reuses its addresses.
+static void forgetCodeCaches() {
+    #if NUMBER_LITERAL_CACHE_SIZE > 0
+        memset(numberLiteralCacheAddressList, 0, sizeof(numberLiteralCacheAddressList));
+    #endif
+    #if BLOCK_CLAUSE_CACHE_SIZE > 0
+        memset(blockClauseCacheStartList, 0, sizeof(blockClauseCacheStartList));
+    #endif
+    #if VARIABLE_CACHE_SIZE > 0
+        memset(variableCacheAddressList, 0, sizeof(variableCacheAddressList));
+    #endif
+}
+
+static void readStorage(void *destination, int32_t address, int32_t amount);
+
+static uint8_t readAllocationTable(uint8_t unit) {
+    uint8_t output;
+    readStorage(&output, getAllocationTableAddress(unit), 1);
+    return output;
+}
+
+// Converts a file address into an EEPROM address. Returns how many
+// bytes starting at the address are stored next to each other.
+static int32_t translateFileAddress(int32_t *address) {
+    int8_t tempIndex = (*address - FILE_VIRTUAL_ADDRESS) / FILE_ENTRY_SIZE;
+    int16_t tempOffset = (*address - FILE_VIRTUAL_ADDRESS) % FILE_ENTRY_SIZE;
+    int32_t tempEntryAddress = getDirectoryEntryAddress(tempIndex);
+    if (tempOffset < FILE_DATA_OFFSET) {
+        *address = tempEntryAddress + tempOffset;
+        return FILE_DATA_OFFSET - tempOffset;
+    }
+    if (tempIndex != storageTranslationIndex) {
+        uint16_t tempStart;
+        readStorage(&tempStart, tempEntryAddress + DIRECTORY_ENTRY_START_OFFSET, 2);
+        storageTranslationIndex = tempIndex;
+        storageTranslationFirstUnit = tempStart / FILE_UNIT_SIZE;
+        storageTranslationPosition = 0;
+        storageTranslationUnit = storageTranslationFirstUnit;
+    }
+    uint8_t tempPosition = tempOffset / FILE_UNIT_SIZE;
+    if (tempPosition < storageTranslationPosition) {
+        storageTranslationPosition = 0;
+        storageTranslationUnit = storageTranslationFirstUnit;
+    }
+    while (storageTranslationPosition < tempPosition) {
+        uint8_t tempNextUnit = readAllocationTable(storageTranslationUnit);
+        if (tempNextUnit >= FILE_UNIT_RESERVED) {
+            // Past the end of the chain. fileSetCapacity makes sure
+            // that nothing is written here.
+            break;
+        }
+        storageTranslationUnit = tempNextUnit;
+        storageTranslationPosition += 1;
+    }
+    int16_t tempUnitOffset = tempOffset % FILE_UNIT_SIZE;
+    *address = (int32_t)storageTranslationUnit * FILE_UNIT_SIZE + tempUnitOffset;
+    return FILE_UNIT_SIZE - tempUnitOffset;
+}
+
+static void readStorage(void *destination, int32_t address, int32_t amount) {
+    if (amount <= 0) {
+        return;
+    }
+    if (address >= FILE_VIRTUAL_ADDRESS) {
+        while (amount > 0) {
+            int32_t tempAddress = address;
+            int32_t tempAmount = translateFileAddress(&tempAddress);
+            if (tempAmount > amount) {
+                tempAmount = amount;
+            }
+            readStorage(destination, tempAddress, tempAmount);
+            destination += tempAmount;
+            address += tempAmount;
+            amount -= tempAmount;
+        }
+        return;
+    }
+    #if STORAGE_CACHE_PAGE_AMOUNT > 0
+        // Bulk reads such as loading the text editor would
+        // only evict the pages which the interpreter uses.
+        if (amount < STORAGE_PAGE_SIZE) {
+            while (amount > 0) {
+                int16_t tempOffset = address % STORAGE_PAGE_SIZE;
+                int16_t tempAmount = STORAGE_PAGE_SIZE - tempOffset;
+                if (tempAmount > amount) {
+                    tempAmount = amount;
+                }
+                uint8_t *tempPage = getStorageCachePage(address / STORAGE_PAGE_SIZE);
+                if (tempPage == NULL) {
+                    readStorageFromSpi(destination, address, tempAmount);
+                } else {
+                    memcpy(destination, tempPage + tempOffset, tempAmount);
+                }
+                destination += tempAmount;
+                address += tempAmount;
+                amount -= tempAmount;
+            }
+            return;
+        }
+    #endif
+    readStorageFromSpi(destination, address, amount);
+}
+
 static void writeStorage(int32_t address, void *source, int32_t amount) {
     if (amount <= 0) {
         return;
     }
-    storageAddress = address;
-    int8_t tempShouldWrite = true;
-    int32_t index = 0;
-    while (tempShouldWrite) {
-        EEPROM_CS_PIN_HIGH;
-        _delay_us(5);
-        EEPROM_CS_PIN_LOW;
-        sendSpiInt8(0x06);
-        EEPROM_CS_PIN_HIGH;
-        _delay_us(5);
-        EEPROM_CS_PIN_LOW;
-        sendSpiInt8(0x02);
-        sendAddressToStorage(storageAddress);
-        while (true) {
-            if (index >= amount) {
-                tempShouldWrite = false;
-                break;
+    if (address >= FILE_VIRTUAL_ADDRESS) {
+        #if NUMBER_LITERAL_CACHE_SIZE > 0
+            forgetNumberLiterals(address, amount);
+        #endif
+        #if BLOCK_CLAUSE_CACHE_SIZE > 0
+            forgetBlockClauses(address, amount);
+        #endif
+        #if VARIABLE_CACHE_SIZE > 0
+            forgetVariableReferences(address, amount);
+        #endif
+        while (amount > 0) {
+            int32_t tempAddress = address;
+            int32_t tempAmount = translateFileAddress(&tempAddress);
+            if (tempAmount > amount) {
+                tempAmount = amount;
             }
-            sendSpiInt8(*(int8_t *)(source + index));
-            storageAddress += 1;
-            index += 1;
-            if (storageAddress % 64 == 0) {
-                break;
+            writeStorage(tempAddress, source, tempAmount);
+            source += tempAmount;
+            address += tempAmount;
+            amount -= tempAmount;
+        }
+        return;
+    }
+    #if STORAGE_CACHE_PAGE_AMOUNT > 0
+        uint16_t tempFirstPage = address / STORAGE_PAGE_SIZE + 1;
+        uint16_t tempLastPage = (address + amount - 1) / STORAGE_PAGE_SIZE + 1;
+        int8_t tempIndex = 0;
+        while (tempIndex < STORAGE_CACHE_PAGE_AMOUNT) {
+            uint16_t tempPage = storageCachePageList[tempIndex];
+            if (tempPage >= tempFirstPage && tempPage <= tempLastPage) {
+                storageCachePageList[tempIndex] = 0;
             }
+            tempIndex += 1;
         }
-        EEPROM_CS_PIN_HIGH;
-        _delay_ms(8);
+    #endif
+    storageStatistics[STORAGE_STATISTIC_WRITTEN_BYTES] += amount;
+    while (amount > 0) {
+        int8_t tempAmount = STORAGE_PAGE_SIZE - address % STORAGE_PAGE_SIZE;
+        if (tempAmount > amount) {
+            tempAmount = amount;
+        }
+        queueStorageWrite(address, source, tempAmount);
+        source += tempAmount;
+        address += tempAmount;
+        amount -= tempAmount;
+    }
+}
+
+// Like writeStorage, but only programs the pages whose
+// contents differ from the EEPROM.
+static void writeChangedStorage(int32_t address, void *source, int32_t amount) {
+    while (amount > 0) {
+        int8_t tempAmount = STORAGE_PAGE_SIZE - address % STORAGE_PAGE_SIZE;
+        if (tempAmount > amount) {
+            tempAmount = amount;
+        }
+        int8_t tempBuffer[STORAGE_PAGE_SIZE];
+        readStorage(tempBuffer, address, tempAmount);
+        if (memcmp(tempBuffer, source, tempAmount) != 0) {
+            writeStorage(address, source, tempAmount);
+        }
+        source += tempAmount;
+        address += tempAmount;
+        amount -= tempAmount;
     }
-    storageAddress = -100;
 }
 
 static int8_t readStorageInt8(int32_t address) {
@@ -1115,6 +1948,54 @@ static float convertTextToFloat(int8_t *text) {
     return atof(text);
 }
 
+static int8_t valueIsNumber(value_t *value) {
+    return (value->type == VALUE_TYPE_NUMBER || value->type == VALUE_TYPE_INTEGER);
+}
+
+// Emulator builds define int32_t as a 64-bit long, so results are
+// checked against the range which the device can hold.
+static int8_t integerFits(int32_t number) {
+    return (number >= -2147483647 - 1 && number <= 2147483647);
+}
+
+static float getNumberValueFloat(value_t *value) {
+    if (value->type == VALUE_TYPE_INTEGER) {
+        return *(int32_t *)(value->data);
+    }
+    return *(float *)(value->data);
+}
+
+// Floats are truncated toward zero.
+static int32_t getNumberValueInteger(value_t *value) {
+    if (value->type == VALUE_TYPE_INTEGER) {
+        return *(int32_t *)(value->data);
+    }
+    return *(float *)(value->data);
+}
+
+static int8_t numberValueIsZero(value_t *value) {
+    if (value->type == VALUE_TYPE_INTEGER) {
+        return (*(int32_t *)(value->data) == 0);
+    }
+    return (*(float *)(value->data) == 0.0);
+}
+
+// Turns an integer into a float in place. Other values are unchanged.
+static void promoteIntegerValue(value_t *value) {
+    if (value->type == VALUE_TYPE_INTEGER) {
+        value->type = VALUE_TYPE_NUMBER;
+        *(float *)(value->data) = *(int32_t *)(value->data);
+    }
+}
+
+static void convertNumberValueToText(int8_t *destination, value_t *value) {
+    if (value->type == VALUE_TYPE_INTEGER) {
+        ltoa(*(int32_t *)(value->data), destination, 10);
+    } else {
+        convertFloatToText(destination, *(float *)(value->data));
+    }
+}
+
 static int16_t getProgMemTextLength(const int8_t *text) {
     int16_t index = 0;
     while (true) {
@@ -1157,10 +2038,67 @@ static void resetHeap() {
     lastAllocation = NULL;
 }
 
+static void resetStorageStatistics() {
+    // Writes queued before the run should not count as its traffic.
+    flushStorageWrites();
+    memset(storageStatistics, 0, sizeof(storageStatistics));
+}
+
+static void resetMemoryStatistics() {
+    memset(memoryStatistics, 0, sizeof(memoryStatistics));
+    memoryStatistics[MEMORY_STATISTIC_LOWEST_HEAP] = sizeof(memory);
+    memoryStatistics[MEMORY_STATISTIC_LARGEST_GAP] = sizeof(memory);
+}
+
+static void updateMemoryStatistics() {
+    int16_t tempHeapOffset = getHeapBoundary() - memory;
+    int16_t tempStackOffset = getStackBoundary() - memory;
+    if (tempHeapOffset < memoryStatistics[MEMORY_STATISTIC_LOWEST_HEAP]) {
+        memoryStatistics[MEMORY_STATISTIC_LOWEST_HEAP] = tempHeapOffset;
+    }
+    if (tempStackOffset > memoryStatistics[MEMORY_STATISTIC_HIGHEST_STACK]) {
+        memoryStatistics[MEMORY_STATISTIC_HIGHEST_STACK] = tempStackOffset;
+    }
+}
+
+static void updateLargestGapStatistic(int16_t largestGap) {
+    if (largestGap < memoryStatistics[MEMORY_STATISTIC_LARGEST_GAP]) {
+        memoryStatistics[MEMORY_STATISTIC_LARGEST_GAP] = largestGap;
+    }
+}
+
+static void reportFailedAllocation(int16_t size, int16_t largestGap) {
+    memoryStatistics[MEMORY_STATISTIC_FAILED_SIZE] = size;
+    updateLargestGapStatistic(largestGap);
+}
+
+// Returns the size of the largest free block between allocations or
+// between the heap and the scope stack, measured like allocate does.
+static int16_t getLargestHeapGap() {
+    int8_t *tempAddress = HEAP_START_ADDRESS;
+    int8_t *tempAllocation = firstAllocation;
+    int16_t output = 0;
+    while (tempAllocation != NULL) {
+        int16_t tempAllocationSize = *(int16_t *)(tempAllocation - ALLOCATION_SIZE_OFFSET);
+        int16_t tempGapSize = tempAddress - (tempAllocation + tempAllocationSize);
+        if (tempGapSize > output) {
+            output = tempGapSize;
+        }
+        tempAddress = tempAllocation - ALLOCATION_HEADER_SIZE;
+        tempAllocation = *(int8_t **)(tempAllocation - ALLOCATION_NEXT_OFFSET);
+    }
+    int16_t tempGapSize = tempAddress - getStackBoundary();
+    if (tempGapSize > output) {
+        output = tempGapSize;
+    }
+    return output;
+}
+
 static int8_t *allocate(int16_t size, int8_t type) {
     int8_t *tempPreviousAllocation = NULL;
     int8_t *tempNextAllocation = firstAllocation;
     int8_t *output;
+    int16_t tempLargestGap = 0;
     while (true) {
         int8_t *tempAddress;
         if (tempPreviousAllocation == NULL) {
@@ -1170,6 +2108,7 @@ static int8_t *allocate(int16_t size, int8_t type) {
         }
         if (tempNextAllocation == NULL) {
             if (tempAddress - memory < size) {
+                reportFailedAllocation(size, tempLargestGap);
                 return NULL;
             }
             output = tempAddress - size;
@@ -1181,10 +2120,18 @@ static int8_t *allocate(int16_t size, int8_t type) {
             output = tempAddress - size;
             break;
         }
+        if (tempGapSize > tempLargestGap) {
+            tempLargestGap = tempGapSize;
+        }
         tempPreviousAllocation = tempNextAllocation;
         tempNextAllocation = *(int8_t **)(tempPreviousAllocation - ALLOCATION_NEXT_OFFSET);
     }
     if (getStackBoundary() > output - ALLOCATION_HEADER_SIZE) {
+        int16_t tempGapSize = output + size - getStackBoundary();
+        if (tempGapSize > tempLargestGap) {
+            tempLargestGap = tempGapSize;
+        }
+        reportFailedAllocation(size, tempLargestGap);
         return NULL;
     }
     *(int8_t **)(output - ALLOCATION_PREVIOUS_OFFSET) = tempPreviousAllocation;
@@ -1202,6 +2149,7 @@ static int8_t *allocate(int16_t size, int8_t type) {
         *(int8_t **)(tempNextAllocation - ALLOCATION_PREVIOUS_OFFSET) = output;
     }
     allocationsSinceMarkAndSweep += 1;
+    updateMemoryStatistics();
     return output;
 }
 
@@ -1307,8 +2255,8 @@ static int8_t *createEmptyList(int16_t length) {
     int16_t index = 0;
     while (index < length) {
         value_t *tempValue = (value_t *)(tempList + LIST_DATA_OFFSET + index * sizeof(value_t));
-        tempValue->type = VALUE_TYPE_NUMBER;
-        *(float *)&(tempValue->data) = 0.0;
+        tempValue->type = VALUE_TYPE_INTEGER;
+        *(int32_t *)&(tempValue->data) = 0;
         index += 1;
     }
     return output;
@@ -1412,9 +2360,9 @@ static void displayStringAllocation(int8_t posX, int8_t posY, int8_t *string) {
 }
 
 static int8_t displayValue(int8_t posX, int8_t posY, value_t *value) {
-    if (value->type == VALUE_TYPE_NUMBER) {
+    if (valueIsNumber(value)) {
         int8_t tempBuffer[NUMBER_LITERAL_MAXIMUM_LENGTH + 1];
-        convertFloatToText(tempBuffer, *(float *)&(value->data));
+        convertNumberValueToText(tempBuffer, value);
         displayText(posX, posY, tempBuffer);
         return true;
     } else if (value->type == VALUE_TYPE_STRING) {
@@ -1521,9 +2469,9 @@ static int8_t printStringAllocation(int8_t *string) {
 }
 
 static int8_t printValue(value_t *value) {
-    if (value->type == VALUE_TYPE_NUMBER) {
+    if (valueIsNumber(value)) {
         int8_t tempBuffer[NUMBER_LITERAL_MAXIMUM_LENGTH + 1];
-        convertFloatToText(tempBuffer, *(float *)&(value->data));
+        convertNumberValueToText(tempBuffer, value);
         int8_t tempResult = printText(tempBuffer);
         return tempResult;
     } else if (value->type == VALUE_TYPE_STRING) {
@@ -1536,14 +2484,15 @@ static int8_t printValue(value_t *value) {
     }
 }
 
-static int8_t menu(int8_t *title, int8_t *optionList) {
-    int8_t *tempList = *(int8_t **)optionList;
-    int16_t tempLength = *(int16_t *)(tempList + LIST_LENGTH_OFFSET);
-    clearDisplay();
-    displayStringAllocation(0, 0, title);
+// Shows one menu option on the second row of the display.
+// Returns false and sets errorMessage on failure.
+typedef int8_t (*menuOptionDisplayer_t)(void *context, int16_t index);
+
+// Lets the user choose one of optionAmount options, which are shown
+// by displayOption. The caller shows the title on the first row.
+static int8_t menu(int16_t optionAmount, menuOptionDisplayer_t displayOption, void *context) {
     displayCharacter(0, 1, '*');
-    value_t *tempValue = (value_t *)(tempList + LIST_DATA_OFFSET);
-    int8_t tempSuccess = displayValue(1, 1, tempValue);
+    int8_t tempSuccess = displayOption(context, 0);
     if (!tempSuccess) {
         return MENU_RESULT_ERROR;
     }
@@ -1554,12 +2503,12 @@ static int8_t menu(int8_t *title, int8_t *optionList) {
         if (tempKey == KEY_CURSOR_UP || tempKey == KEY_CURSOR_LEFT) {
             tempNextIndex -= 1;
             if (tempNextIndex < 0) {
-                tempNextIndex = tempLength - 1;
+                tempNextIndex = optionAmount - 1;
             }
         }
         if (tempKey == KEY_CURSOR_DOWN || tempKey == KEY_CURSOR_RIGHT) {
             tempNextIndex += 1;
-            if (tempNextIndex >= tempLength) {
+            if (tempNextIndex >= optionAmount) {
                 tempNextIndex = 0;
             }
         }
@@ -1571,9 +2520,8 @@ static int8_t menu(int8_t *title, int8_t *optionList) {
         }
         if (tempNextIndex != index) {
             index = tempNextIndex;
-            value_t *tempValue = (value_t *)(tempList + LIST_DATA_OFFSET + index * sizeof(value_t));
             clearDisplayRegion(1, 1, DISPLAY_WIDTH - 1);
-            int8_t tempSuccess = displayValue(1, 1, tempValue);
+            int8_t tempSuccess = displayOption(context, index);
             if (!tempSuccess) {
                 return MENU_RESULT_ERROR;
             }
@@ -1581,6 +2529,20 @@ static int8_t menu(int8_t *title, int8_t *optionList) {
     }
 }
 
+static int8_t displayListMenuOption(void *context, int16_t index) {
+    int8_t *tempList = *(int8_t **)context;
+    value_t *tempValue = (value_t *)(tempList + LIST_DATA_OFFSET + index * sizeof(value_t));
+    return displayValue(1, 1, tempValue);
+}
+
+static int8_t listMenu(int8_t *title, int8_t *optionList) {
+    int8_t *tempList = *(int8_t **)optionList;
+    int16_t tempLength = *(int16_t *)(tempList + LIST_LENGTH_OFFSET);
+    clearDisplay();
+    displayStringAllocation(0, 0, title);
+    return menu(tempLength, displayListMenuOption, optionList);
+}
+
 static int8_t menuWithOptionsFromProgMem(int8_t *title, const int8_t * const *optionList, int8_t optionAmount) {
     int8_t *tempList = createEmptyList(optionAmount);
     if (tempList == NULL) {
@@ -1598,7 +2560,7 @@ static int8_t menuWithOptionsFromProgMem(int8_t *title, const int8_t * const *op
         *(int8_t **)&(tempValue->data) = tempString;
         index += 1;
     }
-    int8_t output = menu(title, tempList);
+    int8_t output = listMenu(title, tempList);
     index = 0;
     while (index < optionAmount) {
         value_t *tempValue = tempListContents + index;
@@ -1610,16 +2572,6 @@ static int8_t menuWithOptionsFromProgMem(int8_t *title, const int8_t * const *op
     return output;
 }
 
-static int8_t menuWithTitleFromProgMem(const int8_t *title, int8_t *optionList) {
-    int8_t *tempTitle = createStringFromProgMem(title);
-    if (tempTitle == NULL) {
-        return MENU_RESULT_ERROR;
-    }
-    int8_t output = menu(tempTitle, optionList);
-    deallocatePointer(tempTitle);
-    return output;
-}
-
 static int8_t menuFromProgMem(const int8_t *title, const int8_t * const *optionList, int8_t optionAmount) {
     int8_t *tempTitle = createStringFromProgMem(title);
     if (tempTitle == NULL) {
@@ -1890,19 +2842,309 @@ static void initializeTextEditor(int8_t *text, int16_t maximumLength, int8_t num
     }
 }
 
+// Hashes file and variable names. readStorageVariableName computes
+// the same hash while it reads a name.
+static uint8_t getNameHash(int8_t *name) {
+    uint8_t output = 0;
+    while (*name != 0) {
+        output = output * 31 + *(uint8_t *)name;
+        name += 1;
+    }
+    return output;
+}
+
+static int8_t fileExists(int8_t index) {
+    return (fileExistsBitmap & ((uint32_t)1 << index)) != 0;
+}
+
+static int32_t getFileAddress(int8_t index) {
+    return FILE_VIRTUAL_ADDRESS + (int32_t)index * FILE_ENTRY_SIZE;
+}
+
+static int8_t getFileIndex(int32_t address) {
+    return (address - FILE_VIRTUAL_ADDRESS) / FILE_ENTRY_SIZE;
+}
+
+static void setFileIndexEntry(int8_t index, int8_t exists, uint8_t hash) {
+    if (exists) {
+        fileExistsBitmap |= (uint32_t)1 << index;
+        fileNameHashList[index] = hash;
+    } else {
+        fileExistsBitmap &= ~((uint32_t)1 << index);
+    }
+}
+
+// Returns how many units a file of the given size needs, counting
+// the unused start of the first unit and the terminating zero.
+static int16_t getFileUnitAmount(int16_t size) {
+    return (FILE_DATA_OFFSET + size + FILE_UNIT_SIZE) / FILE_UNIT_SIZE;
+}
+
+static void writeAllocationTable(uint8_t unit, uint8_t value) {
+    writeStorage(getAllocationTableAddress(unit), &value, 1);
+}
+
+static int16_t getFreeUnitAmount() {
+    int16_t output = 0;
+    int16_t tempUnit = 0;
+    while (tempUnit < FILE_UNIT_AMOUNT) {
+        uint8_t tempTable[STORAGE_PAGE_SIZE];
+        readStorage(tempTable, getAllocationTableAddress(tempUnit), STORAGE_PAGE_SIZE);
+        int8_t index = 0;
+        while (index < STORAGE_PAGE_SIZE) {
+            if (tempTable[index] == FILE_UNIT_FREE) {
+                output += 1;
+            }
+            index += 1;
+        }
+        tempUnit += STORAGE_PAGE_SIZE;
+    }
+    return output;
+}
+
+// Returns the first free unit after the given unit, so that a growing
+// file takes the units next to its end when they are free.
+static uint8_t findFreeUnit(uint8_t unit) {
+    int16_t index = 0;
+    while (index < FILE_UNIT_AMOUNT) {
+        unit += 1;
+        if (readAllocationTable(unit) == FILE_UNIT_FREE) {
+            return unit;
+        }
+        index += 1;
+    }
+    return FILE_UNIT_END;
+}
+
+static void freeUnitChain(uint8_t unit) {
+    while (unit < FILE_UNIT_RESERVED) {
+        uint8_t tempNextUnit = readAllocationTable(unit);
+        writeAllocationTable(unit, FILE_UNIT_FREE);
+        unit = tempNextUnit;
+    }
+}
+
+static uint8_t getFileFirstUnit(int32_t address) {
+    uint16_t tempStart;
+    readStorage(&tempStart, getDirectoryEntryAddress(getFileIndex(address)) + DIRECTORY_ENTRY_START_OFFSET, 2);
+    return tempStart / FILE_UNIT_SIZE;
+}
+
+// Grows or shrinks the unit chain of a file to fit the given size.
+static int8_t fileSetCapacity(int32_t address, int16_t size) {
+    int16_t tempAmount = getFileUnitAmount(size);
+    uint8_t tempUnit = getFileFirstUnit(address);
+    uint8_t tempNextUnit = readAllocationTable(tempUnit);
+    int16_t tempOldAmount = 1;
+    while (tempOldAmount < tempAmount && tempNextUnit < FILE_UNIT_RESERVED) {
+        tempUnit = tempNextUnit;
+        tempNextUnit = readAllocationTable(tempUnit);
+        tempOldAmount += 1;
+    }
+    if (tempOldAmount < tempAmount) {
+        if (getFreeUnitAmount() < tempAmount - tempOldAmount) {
+            errorMessage = ERROR_MESSAGE_STORAGE_IS_FULL;
+            return false;
+        }
+        while (tempOldAmount < tempAmount) {
+            uint8_t tempFreeUnit = findFreeUnit(tempUnit);
+            writeAllocationTable(tempFreeUnit, FILE_UNIT_END);
+            writeAllocationTable(tempUnit, tempFreeUnit);
+            tempUnit = tempFreeUnit;
+            tempOldAmount += 1;
+        }
+    } else if (tempNextUnit < FILE_UNIT_RESERVED) {
+        writeAllocationTable(tempUnit, FILE_UNIT_END);
+        freeUnitChain(tempNextUnit);
+    }
+    storageTranslationIndex = -1;
+    return true;
+}
+
+// Reads the fields at the start of a file in the older layout.
+static void readLegacyFileEntry(int8_t index, uint8_t *entry) {
+    readStorage(entry, (int32_t)index * FILE_SLOT_SIZE, FILE_DATA_OFFSET);
+}
+
+static int8_t getLegacyFileUnitAmount(int8_t index) {
+    uint8_t tempEntry[FILE_DATA_OFFSET];
+    readLegacyFileEntry(index, tempEntry);
+    if (tempEntry[FILE_EXISTS_OFFSET] != FILE_EXISTS_TRUE) {
+        return 0;
+    }
+    int16_t output = getFileUnitAmount(*(int16_t *)(tempEntry + FILE_SIZE_OFFSET));
+    if (output < 1 || output > FILE_SLOT_SIZE / FILE_UNIT_SIZE) {
+        output = FILE_SLOT_SIZE / FILE_UNIT_SIZE;
+    }
+    return output;
+}
+
+// Older firmware had no directory and stored each file in a
+// FILE_SLOT_SIZE slot which began with the fields of a directory entry.
+// Each file keeps its text in place and is given the units of its slot
+// which it needs. The directory takes the place of the last slot, so
+// the file there is first copied to free units. The header then
+// records the copy, and the directory version is written last, so that
+// a conversion which stops halfway resumes from the copy. copiedAmount
+// is the number of copied units when resuming, and -1 otherwise.
+// Returns false without changing anything if there are not enough
+// free units.
+static int8_t convertFileSystem(int8_t copiedAmount) {
+    int8_t tempSlotAmount = DIRECTORY_ADDRESS / FILE_SLOT_SIZE;
+    int8_t tempSlotUnitAmount = FILE_SLOT_SIZE / FILE_UNIT_SIZE;
+    uint8_t tempMovedUnitList[FILE_SLOT_SIZE / FILE_UNIT_SIZE];
+    int8_t tempMovedUnitAmount = copiedAmount;
+    if (copiedAmount < 0) {
+        tempMovedUnitAmount = getLegacyFileUnitAmount(tempSlotAmount);
+        int16_t tempFreeAmount = 0;
+        int8_t index = 0;
+        while (index < tempSlotAmount) {
+            tempFreeAmount += tempSlotUnitAmount - getLegacyFileUnitAmount(index);
+            index += 1;
+        }
+        if (tempFreeAmount < tempMovedUnitAmount) {
+            return false;
+        }
+    }
+    // The other slots never change, so the copy is found again when resuming.
+    int8_t tempAmount = 0;
+    int8_t index = 0;
+    while (index < tempSlotAmount && tempAmount < tempMovedUnitAmount) {
+        int8_t tempUnitIndex = getLegacyFileUnitAmount(index);
+        while (tempUnitIndex < tempSlotUnitAmount && tempAmount < tempMovedUnitAmount) {
+            tempMovedUnitList[tempAmount] = index * tempSlotUnitAmount + tempUnitIndex;
+            tempAmount += 1;
+            tempUnitIndex += 1;
+        }
+        index += 1;
+    }
+    if (copiedAmount < 0) {
+        index = 0;
+        while (index < tempMovedUnitAmount) {
+            int16_t tempOffset = 0;
+            while (tempOffset < FILE_UNIT_SIZE) {
+                uint8_t tempBuffer[STORAGE_PAGE_SIZE];
+                readStorage(tempBuffer, DIRECTORY_ADDRESS + (int32_t)index * FILE_UNIT_SIZE + tempOffset, STORAGE_PAGE_SIZE);
+                writeStorage((int32_t)tempMovedUnitList[index] * FILE_UNIT_SIZE + tempOffset, tempBuffer, STORAGE_PAGE_SIZE);
+                tempOffset += STORAGE_PAGE_SIZE;
+            }
+            index += 1;
+        }
+        // The copy must reach storage before the header which records it.
+        flushStorageWrites();
+        uint16_t tempHeader[2];
+        tempHeader[0] = DIRECTORY_SIGNATURE;
+        tempHeader[1] = DIRECTORY_VERSION_CONVERTING | tempMovedUnitAmount;
+        writeStorage(DIRECTORY_ADDRESS + DIRECTORY_SIGNATURE_OFFSET, tempHeader, 4);
+        flushStorageWrites();
+    }
+    // Each page of the table covers the units of several slots.
+    int16_t tempUnit = 0;
+    while (tempUnit < FILE_UNIT_AMOUNT) {
+        uint8_t tempTable[STORAGE_PAGE_SIZE];
+        int8_t tempUsedAmount = 0;
+        index = 0;
+        while (index < STORAGE_PAGE_SIZE) {
+            int16_t tempSlot = (tempUnit + index) / tempSlotUnitAmount;
+            int8_t tempUnitIndex = (tempUnit + index) % tempSlotUnitAmount;
+            if (tempSlot >= tempSlotAmount) {
+                tempTable[index] = FILE_UNIT_RESERVED;
+            } else {
+                if (tempUnitIndex == 0) {
+                    tempUsedAmount = getLegacyFileUnitAmount(tempSlot);
+                }
+                if (tempUnitIndex < tempUsedAmount - 1) {
+                    tempTable[index] = tempUnit + index + 1;
+                } else if (tempUnitIndex == tempUsedAmount - 1) {
+                    tempTable[index] = FILE_UNIT_END;
+                } else {
+                    tempTable[index] = FILE_UNIT_FREE;
+                }
+            }
+            index += 1;
+        }
+        index = 0;
+        while (index < tempMovedUnitAmount) {
+            int16_t tempTableIndex = tempMovedUnitList[index] - tempUnit;
+            if (tempTableIndex >= 0 && tempTableIndex < STORAGE_PAGE_SIZE) {
+                if (index < tempMovedUnitAmount - 1) {
+                    tempTable[tempTableIndex] = tempMovedUnitList[index + 1];
+                } else {
+                    tempTable[tempTableIndex] = FILE_UNIT_END;
+                }
+            }
+            index += 1;
+        }
+        writeStorage(getAllocationTableAddress(tempUnit), tempTable, STORAGE_PAGE_SIZE);
+        tempUnit += STORAGE_PAGE_SIZE;
+    }
+    index = 0;
+    while (index < FILE_AMOUNT) {
+        uint8_t tempEntry[DIRECTORY_ENTRY_SIZE];
+        uint16_t tempStart = index * FILE_SLOT_SIZE;
+        if (index < tempSlotAmount) {
+            readLegacyFileEntry(index, tempEntry);
+        } else if (tempMovedUnitAmount > 0) {
+            tempStart = tempMovedUnitList[0] * FILE_UNIT_SIZE;
+            readStorage(tempEntry, tempStart, FILE_DATA_OFFSET);
+        } else {
+            tempEntry[FILE_EXISTS_OFFSET] = FILE_EXISTS_FALSE;
+        }
+        if (tempEntry[FILE_EXISTS_OFFSET] == FILE_EXISTS_TRUE) {
+            tempEntry[FILE_NAME_OFFSET + FILE_NAME_MAXIMUM_LENGTH] = 0;
+            tempEntry[DIRECTORY_ENTRY_HASH_OFFSET] = getNameHash(tempEntry + FILE_NAME_OFFSET);
+        } else {
+            tempEntry[FILE_EXISTS_OFFSET] = FILE_EXISTS_FALSE;
+        }
+        *(uint16_t *)(tempEntry + DIRECTORY_ENTRY_START_OFFSET) = tempStart;
+        writeStorage(getDirectoryEntryAddress(index), tempEntry, DIRECTORY_ENTRY_SIZE);
+        index += 1;
+    }
+    flushStorageWrites();
+    uint16_t tempVersion = DIRECTORY_VERSION;
+    writeStorage(DIRECTORY_ADDRESS + DIRECTORY_VERSION_OFFSET, &tempVersion, 2);
+    flushStorageWrites();
+    return true;
+}
+
+// Reads the whole directory in one pass to build the index.
+static void initializeFileSystem() {
+    uint16_t tempHeader[2];
+    readStorage(tempHeader, DIRECTORY_ADDRESS + DIRECTORY_SIGNATURE_OFFSET, 4);
+    int8_t tempSuccess = true;
+    if (tempHeader[0] != DIRECTORY_SIGNATURE) {
+        tempSuccess = convertFileSystem(-1);
+    } else if (tempHeader[1] & DIRECTORY_VERSION_CONVERTING) {
+        tempSuccess = convertFileSystem(tempHeader[1] & 0xFF);
+    }
+    // The image is left untouched, so that an older firmware can still
+    // delete a file to make room.
+    while (!tempSuccess) {
+        printTextFromProgMem(ERROR_MESSAGE_CANNOT_CONVERT_STORAGE);
+    }
+    storageTranslationIndex = -1;
+    int8_t index = 0;
+    while (index < FILE_AMOUNT) {
+        uint8_t tempEntry[DIRECTORY_ENTRY_SIZE];
+        readStorageFromSpi(tempEntry, getDirectoryEntryAddress(index), DIRECTORY_ENTRY_SIZE);
+        setFileIndexEntry(index, tempEntry[FILE_EXISTS_OFFSET] == FILE_EXISTS_TRUE, tempEntry[DIRECTORY_ENTRY_HASH_OFFSET]);
+        index += 1;
+    }
+}
+
 static int32_t fileFindByName(int8_t *name) {
-    int32_t tempAddress = 0;
-    while (tempAddress < STORAGE_SIZE) {
-        uint8_t tempExists;
-        readStorage(&tempExists, tempAddress + FILE_EXISTS_OFFSET, 1);
-        if (tempExists == FILE_EXISTS_TRUE) {
+    uint8_t tempHash = getNameHash(name);
+    int8_t index = 0;
+    while (index < FILE_AMOUNT) {
+        if (fileExists(index) && fileNameHashList[index] == tempHash) {
+            int32_t tempAddress = getFileAddress(index);
             int8_t tempName[FILE_NAME_MAXIMUM_LENGTH + 1];
             readStorage(tempName, tempAddress + FILE_NAME_OFFSET, sizeof(tempName));
             if (strcmp(tempName, name) == 0) {
                 return tempAddress;
             }
         }
-        tempAddress += FILE_ENTRY_SIZE;
+        index += 1;
     }
     return -1;
 }
@@ -1917,21 +3159,31 @@ static int32_t fileCreate(int8_t *name) {
         errorMessage = ERROR_MESSAGE_FILE_EXISTS;
         return -1;
     }
-    int32_t tempAddress = 0;
-    while (tempAddress < STORAGE_SIZE) {
-        uint8_t tempExists;
-        readStorage(&tempExists, tempAddress + FILE_EXISTS_OFFSET, 1);
-        if (tempExists == FILE_EXISTS_FALSE) {
-            tempExists = FILE_EXISTS_TRUE;
-            writeStorage(tempAddress + FILE_EXISTS_OFFSET, &tempExists, 1);
-            writeStorage(tempAddress + FILE_NAME_OFFSET, name, strlen(name) + 1);
-            int16_t tempSize = 0;
+    int8_t index = 0;
+    while (index < FILE_AMOUNT) {
+        if (!fileExists(index)) {
+            uint8_t tempUnit = findFreeUnit(FILE_UNIT_AMOUNT - 1);
+            if (tempUnit == FILE_UNIT_END) {
+                break;
+            }
+            writeAllocationTable(tempUnit, FILE_UNIT_END);
+            forgetCodeCaches();
+            uint8_t tempEntry[DIRECTORY_ENTRY_SIZE];
+            uint8_t tempHash = getNameHash(name);
+            tempEntry[FILE_EXISTS_OFFSET] = FILE_EXISTS_TRUE;
+            strcpy(tempEntry + FILE_NAME_OFFSET, name);
+            *(int16_t *)(tempEntry + FILE_SIZE_OFFSET) = 0;
+            tempEntry[DIRECTORY_ENTRY_HASH_OFFSET] = tempHash;
+            *(uint16_t *)(tempEntry + DIRECTORY_ENTRY_START_OFFSET) = tempUnit * FILE_UNIT_SIZE;
+            writeStorage(getDirectoryEntryAddress(index), tempEntry, DIRECTORY_ENTRY_SIZE);
+            storageTranslationIndex = -1;
+            int32_t tempAddress = getFileAddress(index);
             int8_t tempData = 0;
-            writeStorage(tempAddress + FILE_SIZE_OFFSET, &tempSize, 2);
             writeStorage(tempAddress + FILE_DATA_OFFSET, &tempData, 1);
+            setFileIndexEntry(index, true, tempHash);
             return tempAddress;
         }
-        tempAddress += FILE_ENTRY_SIZE;
+        index += 1;
     }
     errorMessage = ERROR_MESSAGE_STORAGE_IS_FULL;
     return -1;
@@ -1949,17 +3201,70 @@ static int8_t fileSetName(int32_t address, int8_t *newName) {
         return false;
     }
     writeStorage(address + FILE_NAME_OFFSET, newName, tempLength + 1);
+    int8_t tempIndex = getFileIndex(address);
+    uint8_t tempHash = getNameHash(newName);
+    writeStorage(getDirectoryEntryAddress(tempIndex) + DIRECTORY_ENTRY_HASH_OFFSET, &tempHash, 1);
+    setFileIndexEntry(tempIndex, true, tempHash);
     return true;
 }
 
-static int8_t *fileRead(int32_t address, int16_t index, int16_t amount) {
-    int16_t tempSize;
-    readStorage(&tempSize, address + FILE_SIZE_OFFSET, 2);
-    if (index < 0 || index >= tempSize) {
+// Keeps open handles in step with changes made through other
+// handles or by name. A negative size closes the handles.
+static void updateFileHandles(int32_t address, int16_t size) {
+    int8_t index = 0;
+    while (index < FILE_HANDLE_AMOUNT) {
+        fileHandle_t *tempHandle = fileHandleList + index;
+        if (tempHandle->address == address) {
+            if (size < 0) {
+                tempHandle->address = 0;
+            } else {
+                tempHandle->size = size;
+                if (tempHandle->cursor > size) {
+                    tempHandle->cursor = size;
+                }
+            }
+        }
+        index += 1;
+    }
+}
+
+// Returns a free handle, or NULL if all handles are open.
+static fileHandle_t *findFreeFileHandle() {
+    int8_t index = 0;
+    while (index < FILE_HANDLE_AMOUNT) {
+        if (fileHandleList[index].address == 0) {
+            return fileHandleList + index;
+        }
+        index += 1;
+    }
+    return NULL;
+}
+
+static void closeAllFileHandles() {
+    int8_t index = 0;
+    while (index < FILE_HANDLE_AMOUNT) {
+        fileHandleList[index].address = 0;
+        index += 1;
+    }
+}
+
+static void fileDelete(int32_t address) {
+    updateFileHandles(address, -1);
+    forgetCodeCaches();
+    fileGenerationList[getFileIndex(address)] += 1;
+    freeUnitChain(getFileFirstUnit(address));
+    storageTranslationIndex = -1;
+    uint8_t tempExists = FILE_EXISTS_FALSE;
+    writeStorage(address + FILE_EXISTS_OFFSET, &tempExists, 1);
+    setFileIndexEntry(getFileIndex(address), false, 0);
+}
+
+static int8_t *fileRead(int32_t address, int16_t size, int16_t index, int16_t amount) {
+    if (index < 0 || index >= size) {
         errorMessage = ERROR_MESSAGE_BAD_INDEX;
         return NULL;
     }
-    if (index + amount > tempSize) {
+    if (index + amount > size) {
         errorMessage = ERROR_MESSAGE_BAD_AMOUNT;
         return NULL;
     }
@@ -1976,15 +3281,226 @@ static int8_t *fileRead(int32_t address, int16_t index, int16_t amount) {
 
 static int8_t fileWrite(int32_t address, int8_t *text) {
     int16_t tempSize = strlen(text);
-    if (tempSize > FILE_MAXIMUM_SIZE) {
-        errorMessage = ERROR_MESSAGE_BAD_AMOUNT;
+    if (!fileSetCapacity(address, tempSize)) {
         return false;
     }
     writeStorage(address + FILE_SIZE_OFFSET, &tempSize, 2);
     writeStorage(address + FILE_DATA_OFFSET, text, tempSize + 1);
+    updateFileHandles(address, tempSize);
+    return true;
+}
+
+// Checks that amount bytes fit at index, which may be the end of the
+// file, and grows the unit chain if they run past its last unit.
+static int8_t fileReserve(int32_t address, int16_t size, int16_t index, int32_t amount) {
+    if (index < 0 || index > size) {
+        errorMessage = ERROR_MESSAGE_BAD_INDEX;
+        return false;
+    }
+    int32_t tempEnd = (int32_t)index + amount;
+    if (tempEnd <= size) {
+        return true;
+    }
+    if (tempEnd > FILE_ENTRY_SIZE - FILE_DATA_OFFSET - 1) {
+        errorMessage = ERROR_MESSAGE_BAD_AMOUNT;
+        return false;
+    }
+    if (getFileUnitAmount(tempEnd) > getFileUnitAmount(size)) {
+        return fileSetCapacity(address, tempEnd);
+    }
+    return true;
+}
+
+// Moves the end of a file after data was written past it.
+static void fileSetEnd(int32_t address, int16_t size) {
+    int8_t tempTerminator = 0;
+    writeStorage(address + FILE_DATA_OFFSET + size, &tempTerminator, 1);
+    writeStorage(address + FILE_SIZE_OFFSET, &size, 2);
+    updateFileHandles(address, size);
+}
+
+// Writes data into the file starting at index, which may be the end
+// of the file. Only the pages holding the data are programmed, plus
+// the size and terminating zero when the file grows.
+static int8_t fileWriteAt(int32_t address, int16_t size, int16_t index, void *data, int16_t amount) {
+    if (!fileReserve(address, size, index, amount)) {
+        return false;
+    }
+    writeStorage(address + FILE_DATA_OFFSET + index, data, amount);
+    if (index + amount > size) {
+        fileSetEnd(address, index + amount);
+    }
+    return true;
+}
+
+// Writes numbers as raw floats starting at index. A list is packed
+// through a small buffer, and the size is written once at the end.
+static int8_t fileWriteNumbers(int32_t address, int16_t size, int16_t index, value_t *valueList, int16_t amount) {
+    int16_t tempIndex = 0;
+    while (tempIndex < amount) {
+        if (!valueIsNumber(valueList + tempIndex)) {
+            errorMessage = ERROR_MESSAGE_BAD_ARGUMENT_TYPE;
+            return false;
+        }
+        tempIndex += 1;
+    }
+    if (!fileReserve(address, size, index, (int32_t)amount * FILE_NUMBER_SIZE)) {
+        return false;
+    }
+    tempIndex = 0;
+    while (tempIndex < amount) {
+        float tempBuffer[FILE_NUMBER_BUFFER_AMOUNT];
+        int8_t tempCount = 0;
+        while (tempCount < FILE_NUMBER_BUFFER_AMOUNT && tempIndex < amount) {
+            tempBuffer[tempCount] = getNumberValueFloat(valueList + tempIndex);
+            tempCount += 1;
+            tempIndex += 1;
+        }
+        writeStorage(address + FILE_DATA_OFFSET + index, tempBuffer, tempCount * FILE_NUMBER_SIZE);
+        index += tempCount * FILE_NUMBER_SIZE;
+    }
+    if (index > size) {
+        fileSetEnd(address, index);
+    }
+    return true;
+}
+
+// Returns the index of the first newline at or after index, or size
+// if the rest of the file is one line. Reads in small runs so that
+// the scan stays within readStorage's sequential stream.
+static int16_t fileFindLineEnd(int32_t address, int16_t size, int16_t index) {
+    while (index < size) {
+        int8_t tempBuffer[FILE_LINE_SCAN_SIZE];
+        int16_t tempAmount = size - index;
+        if (tempAmount > FILE_LINE_SCAN_SIZE) {
+            tempAmount = FILE_LINE_SCAN_SIZE;
+        }
+        readStorage(tempBuffer, address + FILE_DATA_OFFSET + index, tempAmount);
+        int8_t *tempNewline = memchr(tempBuffer, '\n', tempAmount);
+        if (tempNewline != NULL) {
+            return index + (tempNewline - tempBuffer);
+        }
+        index += tempAmount;
+    }
+    return size;
+}
+
+// Streams the text of one file over another through a page-sized
+// buffer, so copying needs no heap memory. Chunks after the first
+// end on page boundaries so that each is one page program.
+static int8_t fileCopy(int32_t source, int32_t destination) {
+    if (source == destination) {
+        return true;
+    }
+    int16_t tempSize;
+    readStorage(&tempSize, source + FILE_SIZE_OFFSET, 2);
+    if (!fileSetCapacity(destination, tempSize)) {
+        return false;
+    }
+    int16_t index = 0;
+    while (index <= tempSize) {
+        uint8_t tempBuffer[STORAGE_PAGE_SIZE];
+        int16_t tempAmount = STORAGE_PAGE_SIZE - (FILE_DATA_OFFSET + index) % STORAGE_PAGE_SIZE;
+        if (tempAmount > tempSize + 1 - index) {
+            tempAmount = tempSize + 1 - index;
+        }
+        readStorage(tempBuffer, source + FILE_DATA_OFFSET + index, tempAmount);
+        writeStorage(destination + FILE_DATA_OFFSET + index, tempBuffer, tempAmount);
+        index += tempAmount;
+    }
+    writeStorage(destination + FILE_SIZE_OFFSET, &tempSize, 2);
+    updateFileHandles(destination, tempSize);
+    return true;
+}
+
+// Copies a file to the file with the given name, creating it if
+// needed. A file created here is deleted again if the copy fails.
+static int8_t fileCopyToName(int32_t source, int8_t *name) {
+    int32_t tempFile = fileFindByName(name);
+    int8_t tempHasCreatedFile = false;
+    if (tempFile < 0) {
+        tempFile = fileCreate(name);
+        if (tempFile < 0) {
+            return false;
+        }
+        tempHasCreatedFile = true;
+    }
+    if (!fileCopy(source, tempFile)) {
+        if (tempHasCreatedFile) {
+            fileDelete(tempFile);
+        }
+        return false;
+    }
     return true;
 }
 
+// Returns a list value with the names of all files which start with
+// prefix, reading each directory entry once. Returns NULL if memory
+// runs out.
+static int8_t *fileList(int8_t *prefix) {
+    int16_t tempPrefixLength = strlen(prefix);
+    int8_t *tempStringList[FILE_AMOUNT];
+    int8_t tempAmount = 0;
+    int8_t index = 0;
+    while (index < FILE_AMOUNT) {
+        if (fileExists(index)) {
+            int8_t tempName[FILE_NAME_MAXIMUM_LENGTH + 1];
+            readStorage(tempName, getFileAddress(index) + FILE_NAME_OFFSET, sizeof(tempName));
+            if (strncmp(tempName, prefix, tempPrefixLength) == 0) {
+                int8_t *tempString = createString(tempName);
+                if (tempString == NULL) {
+                    return NULL;
+                }
+                tempStringList[tempAmount] = tempString;
+                tempAmount += 1;
+            }
+        }
+        index += 1;
+    }
+    int8_t *output = createEmptyList(tempAmount);
+    if (output == NULL) {
+        return NULL;
+    }
+    value_t *tempListContents = (value_t *)(*(int8_t **)output + LIST_DATA_OFFSET);
+    index = 0;
+    while (index < tempAmount) {
+        value_t *tempValue = tempListContents + index;
+        tempValue->type = VALUE_TYPE_STRING;
+        *(int8_t **)&(tempValue->data) = tempStringList[index];
+        index += 1;
+    }
+    return output;
+}
+
+// Finds the file given by a name or by a handle from fOpen:. Names
+// are looked up into buffer. Returns NULL and sets errorMessage if
+// there is no such file.
+static fileHandle_t *getFileArgument(value_t *value, fileHandle_t *buffer) {
+    if (value->type == VALUE_TYPE_NUMBER) {
+        int16_t tempHandle = *(float *)(value->data);
+        if (tempHandle < 0 || tempHandle >= FILE_HANDLE_AMOUNT || fileHandleList[tempHandle].address == 0) {
+            errorMessage = ERROR_MESSAGE_BAD_HANDLE;
+            return NULL;
+        }
+        return fileHandleList + tempHandle;
+    }
+    if (value->type != VALUE_TYPE_STRING) {
+        errorMessage = ERROR_MESSAGE_BAD_ARGUMENT_TYPE;
+        return NULL;
+    }
+    int8_t *tempPointer = *(int8_t **)(value->data);
+    int8_t *tempString = *(int8_t **)tempPointer;
+    int32_t tempFile = fileFindByName(tempString + STRING_DATA_OFFSET);
+    if (tempFile < 0) {
+        errorMessage = ERROR_MESSAGE_MISSING_FILE;
+        return NULL;
+    }
+    buffer->address = tempFile;
+    readStorage(&(buffer->size), tempFile + FILE_SIZE_OFFSET, 2);
+    buffer->cursor = 0;
+    return buffer;
+}
+
 static void promptCreateFile() {
     int8_t tempResult;
     tempResult = printTextFromProgMem(MESSAGE_ENTER_NAME);
@@ -2027,27 +3543,87 @@ static void promptRenameFile(int32_t address) {
     }
 }
 
-static int8_t promptDeleteFile(int32_t address) {
-    int8_t tempResult = menuFromProgMem(MENU_TITLE_FILE_DELETE, MENU_FILE_DELETE, sizeof(MENU_FILE_DELETE) / sizeof(*MENU_FILE_DELETE));
-    if (tempResult == 1) {
-        uint8_t tempExists = FILE_EXISTS_FALSE;
-        writeStorage(address + FILE_EXISTS_OFFSET, &tempExists, 1);
-        printTextFromProgMem(MESSAGE_FILE_DELETED);
-        return true;
+static void promptCopyFile(int32_t address) {
+    int8_t tempResult;
+    tempResult = printTextFromProgMem(MESSAGE_ENTER_NEW_NAME);
+    if (!tempResult) {
+        return;
     }
-    return false;
-}
-
-static void printFileSize(int16_t size) {
-    int8_t tempBuffer[20];
-    itoa(size, tempBuffer, 10);
-    int8_t index = strlen(tempBuffer);
-    tempBuffer[index] = '/';
+    int8_t tempName[FILE_NAME_MAXIMUM_LENGTH + 1];
+    tempName[0] = 0;
+    initializeTextEditor(tempName, FILE_NAME_MAXIMUM_LENGTH, false);
+    tempResult = runTextEditor();
+    if (!tempResult) {
+        return;
+    }
+    int8_t tempSuccess = fileCopyToName(address, tempName);
+    if (tempSuccess) {
+        printTextFromProgMem(MESSAGE_FILE_COPIED);
+    } else {
+        printTextFromProgMem(errorMessage);
+    }
+}
+
+static int8_t promptDeleteFile(int32_t address) {
+    int8_t tempResult = menuFromProgMem(MENU_TITLE_FILE_DELETE, MENU_FILE_DELETE, sizeof(MENU_FILE_DELETE) / sizeof(*MENU_FILE_DELETE));
+    if (tempResult == 1) {
+        fileDelete(address);
+        printTextFromProgMem(MESSAGE_FILE_DELETED);
+        return true;
+    }
+    return false;
+}
+
+static void printFileSize(int16_t size) {
+    int8_t tempBuffer[20];
+    itoa(size, tempBuffer, 10);
+    int8_t index = strlen(tempBuffer);
+    tempBuffer[index] = '/';
     index += 1;
     itoa(FILE_MAXIMUM_SIZE, tempBuffer + index, 10);
     printText(tempBuffer);
 }
 
+static int8_t printStatistics(const int8_t * const *nameList, uint32_t *valueList, int8_t amount) {
+    int8_t tempBuffer[amount * 20];
+    int16_t index = 0;
+    int8_t tempIndex = 0;
+    while (tempIndex < amount) {
+        if (tempIndex > 0) {
+            tempBuffer[index] = '\n';
+            index += 1;
+        }
+        readProgMemText(tempBuffer + index, pgm_read_ptr((const void **)(nameList + tempIndex)));
+        index += strlen(tempBuffer + index);
+        ultoa(valueList[tempIndex], tempBuffer + index, 10);
+        index += strlen(tempBuffer + index);
+        tempIndex += 1;
+    }
+    return printText(tempBuffer);
+}
+
+// Returns a list value with the given statistics as integers.
+// Statistics which do not fit in an integer become numbers.
+static int8_t *createStatisticsList(uint32_t *valueList, int8_t amount) {
+    int8_t *output = createEmptyList(amount);
+    if (output == NULL) {
+        return NULL;
+    }
+    value_t *tempListContents = (value_t *)(*(int8_t **)output + LIST_DATA_OFFSET);
+    int8_t index = 0;
+    while (index < amount) {
+        value_t *tempValue = tempListContents + index;
+        if (valueList[index] <= 2147483647) {
+            *(int32_t *)(tempValue->data) = valueList[index];
+        } else {
+            tempValue->type = VALUE_TYPE_NUMBER;
+            *(float *)(tempValue->data) = valueList[index];
+        }
+        index += 1;
+    }
+    return output;
+}
+
 static int8_t isUnaryOperator(uint8_t symbol) {
     int8_t index = 0;
     while (index < sizeof(UNARY_OPERATOR_LIST)) {
@@ -2060,8 +3636,11 @@ static int8_t isUnaryOperator(uint8_t symbol) {
     return false;
 }
 
-static int32_t readStorageVariableName(uint8_t *destination, int32_t address) {
+// Reads a variable name into destination and its getNameHash into
+// hash. Returns the address after the name, or -1 on error.
+static int32_t readStorageVariableName(uint8_t *destination, int32_t address, uint8_t *hash) {
     int8_t index = 0;
+    uint8_t tempHash = 0;
     while (true) {
         if (index >= VARIABLE_NAME_MAXIMUM_LENGTH) {
             errorMessage = ERROR_MESSAGE_VARIABLE_NAME_TOO_LONG;
@@ -2078,6 +3657,7 @@ static int32_t readStorageVariableName(uint8_t *destination, int32_t address) {
             }
         }
         destination[index] = tempSymbol;
+        tempHash = tempHash * 31 + tempSymbol;
         address += 1;
         index += 1;
     }
@@ -2086,13 +3666,18 @@ static int32_t readStorageVariableName(uint8_t *destination, int32_t address) {
         return -1;
     }
     destination[index] = 0;
+    *hash = tempHash;
     return address;
 }
 
-static value_t *findVariableValueByNameInScope(uint8_t *name, int8_t *scope) {
-    int8_t *tempVariable = scope + SCOPE_VARIABLE_OFFSET;
+static int8_t **getScopeBucket(int8_t *scope, uint8_t hash) {
+    return (int8_t **)(scope + SCOPE_VARIABLE_OFFSET) + (hash & (SCOPE_BUCKET_AMOUNT - 1));
+}
+
+static value_t *findVariableValueByNameInScope(uint8_t *name, uint8_t hash, int8_t *scope) {
+    int8_t *tempVariable = *getScopeBucket(scope, hash);
     while (tempVariable != NULL) {
-        if (strcmp(name, tempVariable + VARIABLE_NAME_OFFSET) == 0) {
+        if (*(uint8_t *)(tempVariable + VARIABLE_HASH_OFFSET) == hash && strcmp(name, tempVariable + VARIABLE_NAME_OFFSET) == 0) {
             return (value_t *)(tempVariable + VARIABLE_VALUE_OFFSET);
         }
         tempVariable = *(int8_t **)(tempVariable + VARIABLE_NEXT_OFFSET);
@@ -2100,15 +3685,15 @@ static value_t *findVariableValueByNameInScope(uint8_t *name, int8_t *scope) {
     return NULL;
 }
 
-static value_t *findVariableValueByName(uint8_t *name) {
-    value_t *output = findVariableValueByNameInScope(name, localScope);
+static value_t *findVariableValueByName(uint8_t *name, uint8_t hash) {
+    value_t *output = findVariableValueByNameInScope(name, hash, localScope);
     if (output != NULL) {
         return output;
     }
-    return findVariableValueByNameInScope(name, globalScope);
+    return findVariableValueByNameInScope(name, hash, globalScope);
 }
 
-static value_t *createVariable(uint8_t *name) {
+static value_t *createVariable(uint8_t *name, uint8_t hash) {
     int8_t tempLength = strlen(name);
     int16_t tempSize = *(int16_t *)(localScope + SCOPE_SIZE_OFFSET);
     int8_t *tempVariable = localScope + SCOPE_DATA_OFFSET + tempSize;
@@ -2117,8 +3702,12 @@ static value_t *createVariable(uint8_t *name) {
         return NULL;
     }
     *(int16_t *)(localScope + SCOPE_SIZE_OFFSET) = tempSize;
-    *(int8_t **)(tempVariable + VARIABLE_NEXT_OFFSET) = *(int8_t **)(localScope + SCOPE_VARIABLE_OFFSET);
-    *(int8_t **)(localScope + SCOPE_VARIABLE_OFFSET) = tempVariable;
+    updateMemoryStatistics();
+    renewVariableCacheScope();
+    int8_t **tempBucket = getScopeBucket(localScope, hash);
+    *(int8_t **)(tempVariable + VARIABLE_NEXT_OFFSET) = *tempBucket;
+    *tempBucket = tempVariable;
+    *(uint8_t *)(tempVariable + VARIABLE_HASH_OFFSET) = hash;
     strcpy(tempVariable + VARIABLE_NAME_OFFSET, name);
     return (value_t *)(tempVariable + VARIABLE_VALUE_OFFSET);
 }
@@ -2131,6 +3720,7 @@ static branch_t *createBranch() {
         return NULL;
     }
     *(int16_t *)(localScope + SCOPE_SIZE_OFFSET) = tempSize;
+    updateMemoryStatistics();
     branch_t *tempPreviousBranch = *(branch_t **)(localScope + SCOPE_BRANCH_OFFSET);
     if (tempPreviousBranch != NULL) {
         tempPreviousBranch->next = output;
@@ -2182,6 +3772,48 @@ static int32_t skipStorageLine(int32_t address) {
     return address;
 }
 
+// Remembers that the block clause at address is followed by the
+// clause at nextAddress. Ignored clauses start with the address of
+// their line in branch->address, so the next clause at the same depth
+// can record it.
+static void rememberBlockClause(int32_t address, int32_t nextAddress) {
+    #if BLOCK_CLAUSE_CACHE_SIZE > 0
+        if (address == 0) {
+            return;
+        }
+        int8_t tempSlot = getBlockClauseCacheSlot(address);
+        blockClauseCacheStartList[tempSlot] = address;
+        blockClauseCacheEndList[tempSlot] = nextAddress;
+    #endif
+}
+
+// Returns the address of the next clause after the block clause at
+// address, or zero if it is not known and the lines in between have
+// to be skipped one by one.
+static int32_t findNextBlockClause(int32_t address) {
+    #if BLOCK_CLAUSE_CACHE_SIZE > 0
+        int8_t tempSlot = getBlockClauseCacheSlot(address);
+        if (blockClauseCacheStartList[tempSlot] == address) {
+            return blockClauseCacheEndList[tempSlot];
+        }
+    #endif
+    return 0;
+}
+
+// Marks the innermost branch as starting at the current clause, and
+// jumps to the next clause at the same depth if it is known. Returns
+// whether it jumped.
+static int8_t skipBlockClause(expressionStatus_t *status) {
+    branch_t *tempBranch = *(branch_t **)(localScope + SCOPE_BRANCH_OFFSET);
+    tempBranch->address = status->startCode;
+    int32_t tempAddress = findNextBlockClause(status->startCode);
+    if (tempAddress == 0) {
+        return false;
+    }
+    status->code = tempAddress;
+    return true;
+}
+
 static int8_t getCustomFunctionArgumentAmount(int32_t code) {
     int8_t output = 0;
     code += 1;
@@ -2257,6 +3889,7 @@ static void markValueAsReachable(value_t *value) {
 }
 
 static void markAndSweep() {
+    uint16_t tempStartTime = TCNT1;
     int8_t *tempAllocation = firstAllocation;
     while (tempAllocation != NULL) {
         *(int8_t *)(tempAllocation - ALLOCATION_IS_REACHABLE_OFFSET) = false;
@@ -2276,10 +3909,14 @@ static void markAndSweep() {
         }
         if (tempTreasureTracker->type == TREASURE_TYPE_SCOPE) {
             int8_t *tempScope = (int8_t *)(tempTreasureTracker->treasure);
-            int8_t *tempVariable = *(int8_t **)(tempScope + SCOPE_VARIABLE_OFFSET);
-            while (tempVariable != NULL) {
-                markValueAsReachable((value_t *)(tempVariable + VARIABLE_VALUE_OFFSET));
-                tempVariable = *(int8_t **)(tempVariable + VARIABLE_NEXT_OFFSET);
+            int8_t index = 0;
+            while (index < SCOPE_BUCKET_AMOUNT) {
+                int8_t *tempVariable = *getScopeBucket(tempScope, index);
+                while (tempVariable != NULL) {
+                    markValueAsReachable((value_t *)(tempVariable + VARIABLE_VALUE_OFFSET));
+                    tempVariable = *(int8_t **)(tempVariable + VARIABLE_NEXT_OFFSET);
+                }
+                index += 1;
             }
         }
         tempTreasureTracker = tempTreasureTracker->next;
@@ -2294,6 +3931,13 @@ static void markAndSweep() {
     }
     commandsSinceMarkAndSweep = 0;
     allocationsSinceMarkAndSweep = 0;
+    uint32_t tempCycles = (uint32_t)(uint16_t)(TCNT1 - tempStartTime) * MEMORY_TIMER_PRESCALER;
+    memoryStatistics[MEMORY_STATISTIC_COLLECTIONS] += 1;
+    memoryStatistics[MEMORY_STATISTIC_COLLECTION_CYCLES] += tempCycles;
+    if (tempCycles > memoryStatistics[MEMORY_STATISTIC_LONGEST_COLLECTION]) {
+        memoryStatistics[MEMORY_STATISTIC_LONGEST_COLLECTION] = tempCycles;
+    }
+    updateLargestGapStatistic(getLargestHeapGap());
 }
 
 static int8_t insertValueIntoSequence(value_t *sequence, int16_t index, value_t *value) {
@@ -2368,6 +4012,67 @@ static int8_t removeValueFromSequence(value_t *sequence, int16_t index) {
     return removeSubsequenceFromSequence(sequence, index, index + 1);
 }
 
+static void createViewValue(value_t *value, int32_t address) {
+    int8_t tempIndex = getFileIndex(address);
+    value->type = VALUE_TYPE_VIEW;
+    value->data[0] = tempIndex;
+    value->data[1] = fileGenerationList[tempIndex];
+}
+
+static int32_t getViewAddress(value_t *value) {
+    return getFileAddress(value->data[0]);
+}
+
+// Returns the length of a string or view, or -1 and sets errorMessage
+// if the file under a view has been deleted.
+static int16_t getTextValueLength(value_t *value) {
+    if (value->type == VALUE_TYPE_VIEW) {
+        int8_t tempIndex = value->data[0];
+        if (!fileExists(tempIndex) || (uint8_t)value->data[1] != fileGenerationList[tempIndex]) {
+            errorMessage = ERROR_MESSAGE_MISSING_FILE;
+            return -1;
+        }
+        int16_t output;
+        readStorage(&output, getViewAddress(value) + FILE_SIZE_OFFSET, 2);
+        return output;
+    }
+    int8_t *tempString = **(int8_t ***)(value->data);
+    return *(int16_t *)(tempString + STRING_LENGTH_OFFSET);
+}
+
+static void readTextValue(void *destination, value_t *value, int16_t index, int16_t amount) {
+    if (value->type == VALUE_TYPE_VIEW) {
+        readStorage(destination, getViewAddress(value) + FILE_DATA_OFFSET + index, amount);
+    } else {
+        int8_t *tempString = **(int8_t ***)(value->data);
+        memcpy(destination, tempString + STRING_DATA_OFFSET + index, amount);
+    }
+}
+
+// Replaces a view with a string holding a copy of its text, for the
+// operations which need the whole text in memory. Other values are
+// unchanged. Returns false and sets errorMessage on failure.
+static int8_t convertViewToString(value_t *value) {
+    if (value->type != VALUE_TYPE_VIEW) {
+        return true;
+    }
+    int16_t tempLength = getTextValueLength(value);
+    if (tempLength < 0) {
+        return false;
+    }
+    int8_t *tempString = createEmptyString(tempLength);
+    if (tempString == NULL) {
+        errorMessage = ERROR_MESSAGE_STACK_HEAP_COLLISION;
+        return false;
+    }
+    int8_t *tempStringContents = *(int8_t **)tempString;
+    readTextValue(tempStringContents + STRING_DATA_OFFSET, value, 0, tempLength);
+    *(tempStringContents + STRING_DATA_OFFSET + tempLength) = 0;
+    value->type = VALUE_TYPE_STRING;
+    *(int8_t **)(value->data) = tempString;
+    return true;
+}
+
 static value_t getSubsequenceFromSequence(value_t *sequence, int16_t startIndex, int16_t endIndex) {
     value_t output;
     output.type = VALUE_TYPE_MISSING;
@@ -2408,6 +4113,21 @@ static value_t getSubsequenceFromSequence(value_t *sequence, int16_t startIndex,
         memcpy(tempList2 + LIST_DATA_OFFSET, tempList1 + LIST_DATA_OFFSET + startIndex * sizeof(value_t), tempLength2 * sizeof(value_t));
         output.type = VALUE_TYPE_LIST;
         *(int8_t **)(output.data) = tempPointer2;
+    } else if (sequence->type == VALUE_TYPE_VIEW) {
+        int16_t tempLength1 = getTextValueLength(sequence);
+        if (tempLength1 < 0) {
+            return output;
+        }
+        if (startIndex < 0 || startIndex >= tempLength1 || endIndex < 0 || endIndex > tempLength1 || startIndex > endIndex) {
+            errorMessage = ERROR_MESSAGE_BAD_INDEX;
+            return output;
+        }
+        int8_t *tempPointer2 = fileRead(getViewAddress(sequence), tempLength1, startIndex, endIndex - startIndex);
+        if (tempPointer2 == NULL) {
+            return output;
+        }
+        output.type = VALUE_TYPE_STRING;
+        *(int8_t **)(output.data) = tempPointer2;
     } else {
         errorMessage = ERROR_MESSAGE_BAD_ARGUMENT_TYPE;
     }
@@ -2487,6 +4207,39 @@ static int8_t stringsAreEqual(int8_t *string1, int8_t *string2) {
     return true;
 }
 
+// Compares two strings or views. Views are read from storage in
+// small runs, so no copy of the file is made in memory. Returns -1
+// and sets errorMessage if a view's file is missing.
+static int8_t textValuesAreEqual(value_t *value1, value_t *value2) {
+    if (value1->type == VALUE_TYPE_STRING && value2->type == VALUE_TYPE_STRING) {
+        return stringsAreEqual(*(int8_t **)(value1->data), *(int8_t **)(value2->data));
+    }
+    int16_t tempLength = getTextValueLength(value1);
+    int16_t tempLength2 = getTextValueLength(value2);
+    if (tempLength < 0 || tempLength2 < 0) {
+        return -1;
+    }
+    if (tempLength != tempLength2) {
+        return false;
+    }
+    int16_t index = 0;
+    while (index < tempLength) {
+        int8_t tempBuffer1[FILE_VIEW_COMPARE_SIZE];
+        int8_t tempBuffer2[FILE_VIEW_COMPARE_SIZE];
+        int16_t tempAmount = tempLength - index;
+        if (tempAmount > FILE_VIEW_COMPARE_SIZE) {
+            tempAmount = FILE_VIEW_COMPARE_SIZE;
+        }
+        readTextValue(tempBuffer1, value1, index, tempAmount);
+        readTextValue(tempBuffer2, value2, index, tempAmount);
+        if (memcmp(tempBuffer1, tempBuffer2, tempAmount) != 0) {
+            return false;
+        }
+        index += tempAmount;
+    }
+    return true;
+}
+
 static void reportError(const int8_t *message, int32_t code) {
     errorMessage = message;
     errorCode = code;
@@ -2520,14 +4273,17 @@ static void __attribute__ ((noinline)) evaluateControlFunction(expressionStatus_
         status->result.value = status->argumentList[0];
     }
     if (status->symbol == SYMBOL_IF) {
-        if ((status->argumentList + 0)->type != VALUE_TYPE_NUMBER) {
+        if (!valueIsNumber(status->argumentList + 0)) {
             reportError(ERROR_MESSAGE_BAD_ARGUMENT_TYPE, status->startCode);
             status->result.status = EVALUATION_STATUS_QUIT;
             return;
         }
         int8_t tempSuccess;
-        if (*(float *)((status->argumentList + 0)->data) == 0.0) {
+        if (numberValueIsZero(status->argumentList + 0)) {
             tempSuccess = pushBranch(BRANCH_ACTION_IGNORE_SOFT, 0);
+            if (tempSuccess) {
+                skipBlockClause(status);
+            }
         } else {
             tempSuccess = pushBranch(BRANCH_ACTION_RUN, 0);
         }
@@ -2536,21 +4292,23 @@ static void __attribute__ ((noinline)) evaluateControlFunction(expressionStatus_
             return;
         }
     }
-    if (status->symbol == SYMBOL_ELSE_IF) {
-        status->branch->action = BRANCH_ACTION_IGNORE_HARD;
-    }
-    if (status->symbol == SYMBOL_ELSE) {
+    if (status->symbol == SYMBOL_ELSE_IF || status->symbol == SYMBOL_ELSE) {
+        rememberBlockClause(status->branch->address, status->startCode);
         status->branch->action = BRANCH_ACTION_IGNORE_HARD;
+        skipBlockClause(status);
     }
     if (status->symbol == SYMBOL_WHILE) {
-        if ((status->argumentList + 0)->type != VALUE_TYPE_NUMBER) {
+        if (!valueIsNumber(status->argumentList + 0)) {
             reportError(ERROR_MESSAGE_BAD_ARGUMENT_TYPE, status->startCode);
             status->result.status = EVALUATION_STATUS_QUIT;
             return;
         }
         int8_t tempSuccess;
-        if (*(float *)((status->argumentList + 0)->data) == 0.0) {
+        if (numberValueIsZero(status->argumentList + 0)) {
             tempSuccess = pushBranch(BRANCH_ACTION_IGNORE_HARD, 0);
+            if (tempSuccess) {
+                skipBlockClause(status);
+            }
         } else {
             tempSuccess = pushBranch(BRANCH_ACTION_LOOP, status->startCode);
         }
@@ -2614,14 +4372,15 @@ static void __attribute__ ((noinline)) evaluateControlFunction(expressionStatus_
     if (status->symbol == SYMBOL_FUNCTION) {
         volatile int16_t tempCheatSize = VARIABLE_NAME_MAXIMUM_LENGTH + 1;
         uint8_t tempBuffer[tempCheatSize];
-        int32_t tempCode = readStorageVariableName(tempBuffer, status->expressionList[0]);
+        uint8_t tempHash;
+        int32_t tempCode = readStorageVariableName(tempBuffer, status->expressionList[0], &tempHash);
         if (tempCode < 0) {
             status->result.status = EVALUATION_STATUS_QUIT;
             return;
         }
-        value_t *tempValue = findVariableValueByName(tempBuffer);
+        value_t *tempValue = findVariableValueByName(tempBuffer, tempHash);
         if (tempValue == NULL) {
-            tempValue = createVariable(tempBuffer);
+            tempValue = createVariable(tempBuffer, tempHash);
             if (tempValue == NULL) {
                 reportError(ERROR_MESSAGE_STACK_HEAP_COLLISION, status->startCode);
                 status->result.status = EVALUATION_STATUS_QUIT;
@@ -2635,6 +4394,7 @@ static void __attribute__ ((noinline)) evaluateControlFunction(expressionStatus_
             status->result.status = EVALUATION_STATUS_QUIT;
             return;
         }
+        skipBlockClause(status);
     }
 }
 
@@ -2742,6 +4502,11 @@ static void __attribute__ ((noinline)) evaluateMathFunction(expressionStatus_t *
 static void __attribute__ ((noinline)) evaluateInputOutputFunction(expressionStatus_t *status) {
     int8_t tempShouldDisplayRunning = false;
     if (status->symbol == SYMBOL_PRINT) {
+        if (!convertViewToString(status->argumentList + 0)) {
+            reportError(errorMessage, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
+        }
         int8_t tempResult2 = printValue(status->argumentList + 0);
         if (!tempResult2) {
             if (errorMessage != NULL) {
@@ -2800,7 +4565,7 @@ static void __attribute__ ((noinline)) evaluateInputOutputFunction(expressionSta
         }
         int8_t *tempTitle = *(int8_t **)((status->argumentList + 0)->data);
         int8_t *tempList = *(int8_t **)((status->argumentList + 1)->data);
-        int8_t tempResult2 = menu(tempTitle, tempList);
+        int8_t tempResult2 = listMenu(tempTitle, tempList);
         if (tempResult2 == MENU_RESULT_ERROR) {
             errorCode = status->startCode;
             status->result.status = EVALUATION_STATUS_QUIT;
@@ -2827,23 +4592,15 @@ static void __attribute__ ((noinline)) evaluateInputOutputFunction(expressionSta
         *(float *)(status->result.value.data) = (tempFile >= 0);
     }
     if (status->symbol == SYMBOL_FILE_SIZE) {
-        if ((status->argumentList + 0)->type != VALUE_TYPE_STRING) {
-            reportError(ERROR_MESSAGE_BAD_ARGUMENT_TYPE, status->startCode);
+        fileHandle_t tempBuffer;
+        fileHandle_t *tempHandle = getFileArgument(status->argumentList + 0, &tempBuffer);
+        if (tempHandle == NULL) {
+            reportError(errorMessage, status->startCode);
             status->result.status = EVALUATION_STATUS_QUIT;
             return;
         }
-        int8_t *tempPointer = *(int8_t **)((status->argumentList + 0)->data);
-        int8_t *tempString = *(int8_t **)tempPointer;
-        int32_t tempFile = fileFindByName(tempString + STRING_DATA_OFFSET);
-        if (tempFile < 0) {
-            reportError(ERROR_MESSAGE_MISSING_FILE, status->startCode);
-            status->result.status = EVALUATION_STATUS_QUIT;
-            return;
-        }
-        int16_t tempSize;
-        readStorage(&tempSize, tempFile + FILE_SIZE_OFFSET, 2);
         status->result.value.type = VALUE_TYPE_NUMBER;
-        *(float *)(status->result.value.data) = tempSize;
+        *(float *)(status->result.value.data) = tempHandle->size;
     }
     if (status->symbol == SYMBOL_FILE_CREATE) {
         if ((status->argumentList + 0)->type != VALUE_TYPE_STRING) {
@@ -2874,8 +4631,7 @@ static void __attribute__ ((noinline)) evaluateInputOutputFunction(expressionSta
             status->result.status = EVALUATION_STATUS_QUIT;
             return;
         }
-        uint8_t tempStatus = FILE_EXISTS_FALSE;
-        writeStorage(tempFile + FILE_EXISTS_OFFSET, &tempStatus, 1);
+        fileDelete(tempFile);
     }
     if (status->symbol == SYMBOL_FILE_SET_NAME) {
         if ((status->argumentList + 0)->type != VALUE_TYPE_STRING || (status->argumentList + 1)->type != VALUE_TYPE_STRING) {
@@ -2901,53 +4657,268 @@ static void __attribute__ ((noinline)) evaluateInputOutputFunction(expressionSta
         }
     }
     if (status->symbol == SYMBOL_FILE_READ) {
-        if ((status->argumentList + 0)->type != VALUE_TYPE_STRING || (status->argumentList + 1)->type != VALUE_TYPE_NUMBER
-                || (status->argumentList + 2)->type != VALUE_TYPE_NUMBER) {
+        if ((status->argumentList + 1)->type != VALUE_TYPE_NUMBER || (status->argumentList + 2)->type != VALUE_TYPE_NUMBER) {
             reportError(ERROR_MESSAGE_BAD_ARGUMENT_TYPE, status->startCode);
             status->result.status = EVALUATION_STATUS_QUIT;
             return;
         }
-        int8_t *tempPointer = *(int8_t **)((status->argumentList + 0)->data);
         float tempIndex = *(float *)((status->argumentList + 1)->data);
         float tempAmount = *(float *)((status->argumentList + 2)->data);
-        int8_t *tempString = *(int8_t **)tempPointer;
-        int32_t tempFile = fileFindByName(tempString + STRING_DATA_OFFSET);
-        if (tempFile < 0) {
-            reportError(ERROR_MESSAGE_MISSING_FILE, status->startCode);
+        fileHandle_t tempBuffer;
+        fileHandle_t *tempHandle = getFileArgument(status->argumentList + 0, &tempBuffer);
+        if (tempHandle == NULL) {
+            reportError(errorMessage, status->startCode);
             status->result.status = EVALUATION_STATUS_QUIT;
             return;
         }
-        int8_t *tempResult2 = fileRead(tempFile, tempIndex, tempAmount);
+        int8_t *tempResult2 = fileRead(tempHandle->address, tempHandle->size, tempIndex, tempAmount);
         if (tempResult2 == NULL) {
             errorCode = status->startCode;
             status->result.status = EVALUATION_STATUS_QUIT;
             return;
         }
+        tempHandle->cursor = tempIndex + tempAmount;
         status->result.value.type = VALUE_TYPE_STRING;
         *(int8_t **)(status->result.value.data) = tempResult2;
     }
     if (status->symbol == SYMBOL_FILE_WRITE) {
-        if ((status->argumentList + 0)->type != VALUE_TYPE_STRING || (status->argumentList + 1)->type != VALUE_TYPE_STRING) {
+        if (!convertViewToString(status->argumentList + 1)) {
+            reportError(errorMessage, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
+        }
+        if ((status->argumentList + 1)->type != VALUE_TYPE_STRING) {
             reportError(ERROR_MESSAGE_BAD_ARGUMENT_TYPE, status->startCode);
             status->result.status = EVALUATION_STATUS_QUIT;
             return;
         }
-        int8_t *tempPointer1 = *(int8_t **)((status->argumentList + 0)->data);
-        int8_t *tempPointer2 = *(int8_t **)((status->argumentList + 1)->data);
-        int8_t *tempString1 = *(int8_t **)tempPointer1;
-        int8_t *tempString2 = *(int8_t **)tempPointer2;
-        int32_t tempFile = fileFindByName(tempString1 + STRING_DATA_OFFSET);
-        if (tempFile < 0) {
-            reportError(ERROR_MESSAGE_MISSING_FILE, status->startCode);
+        int8_t *tempPointer = *(int8_t **)((status->argumentList + 1)->data);
+        int8_t *tempString = *(int8_t **)tempPointer;
+        fileHandle_t tempBuffer;
+        fileHandle_t *tempHandle = getFileArgument(status->argumentList + 0, &tempBuffer);
+        if (tempHandle == NULL) {
+            reportError(errorMessage, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
+        }
+        int8_t tempSuccess = fileWrite(tempHandle->address, tempString + STRING_DATA_OFFSET);
+        if (!tempSuccess) {
+            errorCode = status->startCode;
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
+        }
+        tempHandle->cursor = tempHandle->size;
+    }
+    if (status->symbol == SYMBOL_FILE_APPEND || status->symbol == SYMBOL_FILE_WRITE_AT) {
+        value_t *tempText = status->argumentList + 1;
+        if (status->symbol == SYMBOL_FILE_WRITE_AT) {
+            tempText = status->argumentList + 2;
+            if ((status->argumentList + 1)->type != VALUE_TYPE_NUMBER) {
+                reportError(ERROR_MESSAGE_BAD_ARGUMENT_TYPE, status->startCode);
+                status->result.status = EVALUATION_STATUS_QUIT;
+                return;
+            }
+        }
+        if (!convertViewToString(tempText)) {
+            reportError(errorMessage, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
+        }
+        if (tempText->type != VALUE_TYPE_STRING) {
+            reportError(ERROR_MESSAGE_BAD_ARGUMENT_TYPE, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
+        }
+        int8_t *tempPointer = *(int8_t **)(tempText->data);
+        int8_t *tempString = *(int8_t **)tempPointer;
+        fileHandle_t tempBuffer;
+        fileHandle_t *tempHandle = getFileArgument(status->argumentList + 0, &tempBuffer);
+        if (tempHandle == NULL) {
+            reportError(errorMessage, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
+        }
+        int16_t tempIndex = tempHandle->size;
+        if (status->symbol == SYMBOL_FILE_WRITE_AT) {
+            tempIndex = *(float *)((status->argumentList + 1)->data);
+        }
+        int16_t tempLength = *(int16_t *)(tempString + STRING_LENGTH_OFFSET);
+        int8_t tempSuccess = fileWriteAt(tempHandle->address, tempHandle->size, tempIndex, tempString + STRING_DATA_OFFSET, tempLength);
+        if (!tempSuccess) {
+            errorCode = status->startCode;
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
+        }
+        tempHandle->cursor = tempIndex + tempLength;
+    }
+    if (status->symbol == SYMBOL_FILE_COPY) {
+        if ((status->argumentList + 1)->type != VALUE_TYPE_STRING) {
+            reportError(ERROR_MESSAGE_BAD_ARGUMENT_TYPE, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
+        }
+        int8_t *tempPointer = *(int8_t **)((status->argumentList + 1)->data);
+        int8_t *tempString = *(int8_t **)tempPointer;
+        fileHandle_t tempBuffer;
+        fileHandle_t *tempHandle = getFileArgument(status->argumentList + 0, &tempBuffer);
+        if (tempHandle == NULL) {
+            reportError(errorMessage, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
+        }
+        int8_t tempSuccess = fileCopyToName(tempHandle->address, tempString + STRING_DATA_OFFSET);
+        if (!tempSuccess) {
+            errorCode = status->startCode;
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
+        }
+    }
+    if (status->symbol == SYMBOL_FILE_LIST) {
+        if ((status->argumentList + 0)->type != VALUE_TYPE_STRING) {
+            reportError(ERROR_MESSAGE_BAD_ARGUMENT_TYPE, status->startCode);
             status->result.status = EVALUATION_STATUS_QUIT;
             return;
         }
-        int8_t tempSuccess = fileWrite(tempFile, tempString2 + STRING_DATA_OFFSET);
+        int8_t *tempPointer = *(int8_t **)((status->argumentList + 0)->data);
+        int8_t *tempString = *(int8_t **)tempPointer;
+        int8_t *tempList = fileList(tempString + STRING_DATA_OFFSET);
+        if (tempList == NULL) {
+            reportError(ERROR_MESSAGE_STACK_HEAP_COLLISION, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
+        }
+        status->result.value.type = VALUE_TYPE_LIST;
+        *(int8_t **)(status->result.value.data) = tempList;
+    }
+    if (status->symbol == SYMBOL_FILE_VIEW) {
+        fileHandle_t tempBuffer;
+        fileHandle_t *tempHandle = getFileArgument(status->argumentList + 0, &tempBuffer);
+        if (tempHandle == NULL) {
+            reportError(errorMessage, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
+        }
+        createViewValue(&(status->result.value), tempHandle->address);
+    }
+    if (status->symbol == SYMBOL_FILE_READ_NUMBER) {
+        if ((status->argumentList + 1)->type != VALUE_TYPE_NUMBER) {
+            reportError(ERROR_MESSAGE_BAD_ARGUMENT_TYPE, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
+        }
+        int32_t tempIndex = *(float *)((status->argumentList + 1)->data);
+        fileHandle_t tempBuffer;
+        fileHandle_t *tempHandle = getFileArgument(status->argumentList + 0, &tempBuffer);
+        if (tempHandle == NULL) {
+            reportError(errorMessage, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
+        }
+        if (tempIndex < 0 || tempIndex + FILE_NUMBER_SIZE > tempHandle->size) {
+            reportError(ERROR_MESSAGE_BAD_INDEX, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
+        }
+        readStorage(status->result.value.data, tempHandle->address + FILE_DATA_OFFSET + tempIndex, FILE_NUMBER_SIZE);
+        tempHandle->cursor = tempIndex + FILE_NUMBER_SIZE;
+        status->result.value.type = VALUE_TYPE_NUMBER;
+    }
+    if (status->symbol == SYMBOL_FILE_WRITE_NUMBER) {
+        if ((status->argumentList + 1)->type != VALUE_TYPE_NUMBER) {
+            reportError(ERROR_MESSAGE_BAD_ARGUMENT_TYPE, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
+        }
+        int16_t tempIndex = *(float *)((status->argumentList + 1)->data);
+        value_t *tempValueList = status->argumentList + 2;
+        int16_t tempAmount = 1;
+        if (tempValueList->type == VALUE_TYPE_LIST) {
+            int8_t *tempPointer = *(int8_t **)(tempValueList->data);
+            int8_t *tempList = *(int8_t **)tempPointer;
+            tempAmount = *(int16_t *)(tempList + LIST_LENGTH_OFFSET);
+            tempValueList = (value_t *)(tempList + LIST_DATA_OFFSET);
+        }
+        fileHandle_t tempBuffer;
+        fileHandle_t *tempHandle = getFileArgument(status->argumentList + 0, &tempBuffer);
+        if (tempHandle == NULL) {
+            reportError(errorMessage, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
+        }
+        int8_t tempSuccess = fileWriteNumbers(tempHandle->address, tempHandle->size, tempIndex, tempValueList, tempAmount);
         if (!tempSuccess) {
             errorCode = status->startCode;
             status->result.status = EVALUATION_STATUS_QUIT;
             return;
         }
+        tempHandle->cursor = tempIndex + tempAmount * FILE_NUMBER_SIZE;
+    }
+    if (status->symbol == SYMBOL_FILE_OPEN) {
+        fileHandle_t tempBuffer;
+        fileHandle_t *tempHandle = getFileArgument(status->argumentList + 0, &tempBuffer);
+        if (tempHandle == NULL) {
+            reportError(errorMessage, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
+        }
+        fileHandle_t *tempFreeHandle = findFreeFileHandle();
+        if (tempFreeHandle == NULL) {
+            reportError(ERROR_MESSAGE_TOO_MANY_OPEN_FILES, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
+        }
+        *tempFreeHandle = *tempHandle;
+        status->result.value.type = VALUE_TYPE_NUMBER;
+        *(float *)(status->result.value.data) = tempFreeHandle - fileHandleList;
+    }
+    if (status->symbol == SYMBOL_FILE_READ_LINE) {
+        fileHandle_t tempBuffer;
+        // Only a handle keeps the cursor between calls.
+        if ((status->argumentList + 0)->type != VALUE_TYPE_NUMBER) {
+            reportError(ERROR_MESSAGE_BAD_ARGUMENT_TYPE, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
+        }
+        fileHandle_t *tempHandle = getFileArgument(status->argumentList + 0, &tempBuffer);
+        if (tempHandle == NULL) {
+            reportError(errorMessage, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
+        }
+        // The end of the file gives the number 0 instead of a string.
+        status->result.value.type = VALUE_TYPE_NUMBER;
+        *(float *)(status->result.value.data) = 0;
+        if (tempHandle->cursor < tempHandle->size) {
+            int16_t tempEnd = fileFindLineEnd(tempHandle->address, tempHandle->size, tempHandle->cursor);
+            int16_t tempLength = tempEnd - tempHandle->cursor;
+            int8_t *tempPointer = createEmptyString(tempLength);
+            if (tempPointer == NULL) {
+                reportError(ERROR_MESSAGE_STACK_HEAP_COLLISION, status->startCode);
+                status->result.status = EVALUATION_STATUS_QUIT;
+                return;
+            }
+            int8_t *tempString = *(int8_t **)tempPointer;
+            readStorage(tempString + STRING_DATA_OFFSET, tempHandle->address + FILE_DATA_OFFSET + tempHandle->cursor, tempLength);
+            *(tempString + STRING_DATA_OFFSET + tempLength) = 0;
+            tempHandle->cursor = tempEnd + 1;
+            status->result.value.type = VALUE_TYPE_STRING;
+            *(int8_t **)(status->result.value.data) = tempPointer;
+        }
+    }
+    if (status->symbol == SYMBOL_FILE_CLOSE) {
+        fileHandle_t tempBuffer;
+        if ((status->argumentList + 0)->type != VALUE_TYPE_NUMBER) {
+            reportError(ERROR_MESSAGE_BAD_ARGUMENT_TYPE, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
+        }
+        fileHandle_t *tempHandle = getFileArgument(status->argumentList + 0, &tempBuffer);
+        if (tempHandle == NULL) {
+            reportError(errorMessage, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
+        }
+        tempHandle->address = 0;
     }
     if (status->symbol == SYMBOL_FILE_IMPORT) {
         if ((status->argumentList + 0)->type != VALUE_TYPE_STRING) {
@@ -2969,6 +4940,22 @@ static void __attribute__ ((noinline)) evaluateInputOutputFunction(expressionSta
             return;
         }
     }
+    if (status->symbol == SYMBOL_STORAGE_STATISTICS || status->symbol == SYMBOL_MEMORY_STATISTICS) {
+        int8_t *tempPointer;
+        if (status->symbol == SYMBOL_STORAGE_STATISTICS) {
+            tempPointer = createStatisticsList(storageStatistics, STORAGE_STATISTIC_AMOUNT);
+        } else {
+            memoryStatistics[MEMORY_STATISTIC_NATIVE_STACK_FREE] = getNativeStackFree();
+            tempPointer = createStatisticsList(memoryStatistics, MEMORY_STATISTIC_AMOUNT);
+        }
+        if (tempPointer == NULL) {
+            reportError(ERROR_MESSAGE_STACK_HEAP_COLLISION, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
+        }
+        status->result.value.type = VALUE_TYPE_LIST;
+        *(int8_t **)(status->result.value.data) = tempPointer;
+    }
     if (tempShouldDisplayRunning) {
         clearDisplay();
         displayTextFromProgMem(0, 0, MESSAGE_RUNNING);
@@ -2993,10 +4980,10 @@ static void __attribute__ ((noinline)) evaluateValueFunction(expressionStatus_t
     }
     if (status->symbol == SYMBOL_STRING) {
         int8_t tempType = (status->argumentList + 0)->type;
-        if (tempType == VALUE_TYPE_NUMBER) {
+        if (tempType == VALUE_TYPE_NUMBER || tempType == VALUE_TYPE_INTEGER) {
             volatile int16_t tempCheatSize = NUMBER_LITERAL_MAXIMUM_LENGTH + 1;
             uint8_t tempBuffer[tempCheatSize];
-            convertFloatToText(tempBuffer, *(float *)((status->argumentList + 0)->data));
+            convertNumberValueToText(tempBuffer, status->argumentList + 0);
             status->result.value.type = VALUE_TYPE_STRING;
             int8_t *tempString = createString(tempBuffer);
             if (tempString == NULL) {
@@ -3007,6 +4994,13 @@ static void __attribute__ ((noinline)) evaluateValueFunction(expressionStatus_t
             *(int8_t **)(status->result.value.data) = tempString;
         } else if (tempType == VALUE_TYPE_STRING) {
             status->result.value = status->argumentList[0];
+        } else if (tempType == VALUE_TYPE_VIEW) {
+            status->result.value = status->argumentList[0];
+            if (!convertViewToString(&(status->result.value))) {
+                reportError(errorMessage, status->startCode);
+                status->result.status = EVALUATION_STATUS_QUIT;
+                return;
+            }
         } else {
             reportError(ERROR_MESSAGE_BAD_ARGUMENT_TYPE, status->startCode);
             status->result.status = EVALUATION_STATUS_QUIT;
@@ -3022,13 +5016,22 @@ static void __attribute__ ((noinline)) evaluateValueFunction(expressionStatus_t
         if (tempType == VALUE_TYPE_STRING) {
             int8_t *tempPointer = *(int8_t **)((status->argumentList + 0)->data);
             int8_t *tempString = *(int8_t **)tempPointer;
-            status->result.value.type = VALUE_TYPE_NUMBER;
-            *(float *)(status->result.value.data) = *(int16_t *)(tempString + STRING_LENGTH_OFFSET);
+            status->result.value.type = VALUE_TYPE_INTEGER;
+            *(int32_t *)(status->result.value.data) = *(int16_t *)(tempString + STRING_LENGTH_OFFSET);
         } else if (tempType == VALUE_TYPE_LIST) {
             int8_t *tempPointer = *(int8_t **)((status->argumentList + 0)->data);
             int8_t *tempList = *(int8_t **)tempPointer;
-            status->result.value.type = VALUE_TYPE_NUMBER;
-            *(float *)(status->result.value.data) = *(int16_t *)(tempList + LIST_LENGTH_OFFSET);
+            status->result.value.type = VALUE_TYPE_INTEGER;
+            *(int32_t *)(status->result.value.data) = *(int16_t *)(tempList + LIST_LENGTH_OFFSET);
+        } else if (tempType == VALUE_TYPE_VIEW) {
+            int16_t tempLength = getTextValueLength(status->argumentList + 0);
+            if (tempLength < 0) {
+                reportError(errorMessage, status->startCode);
+                status->result.status = EVALUATION_STATUS_QUIT;
+                return;
+            }
+            status->result.value.type = VALUE_TYPE_INTEGER;
+            *(int32_t *)(status->result.value.data) = tempLength;
         } else {
             reportError(ERROR_MESSAGE_BAD_ARGUMENT_TYPE, status->startCode);
             status->result.status = EVALUATION_STATUS_QUIT;
@@ -3156,314 +5159,296 @@ static void __attribute__ ((noinline)) evaluateValueFunction(expressionStatus_t
     }
 }
 
-static void __attribute__ ((noinline)) evaluateBinaryOperatorExpression1(expressionStatus_t *status, int8_t index, int8_t precedence) {
-    status->code += 1;
-    expressionResult_t tempResult2 = evaluateExpression(status->code, precedence, false);
-    firstTreasureTracker = &status->treasureTracker;
-    treasureTracker_t tempTreasureTracker2;
-    initializeTreasureTracker(&tempTreasureTracker2, TREASURE_TYPE_VALUE, &(tempResult2.value));
-    if (tempResult2.status != EVALUATION_STATUS_NORMAL) {
-        status->result.status = tempResult2.status;
-        return;
-    }
-    if (tempResult2.value.type == VALUE_TYPE_MISSING) {
-        reportError(ERROR_MESSAGE_MISSING_VALUE, status->startCode);
-        status->result.status = EVALUATION_STATUS_QUIT;
-        return;
+// Applies a binary operator to two numbers and stores the result in
+// value1. Integer operands give an integer result unless it needs a
+// fraction or overflows. Returns false and sets errorMessage on failure.
+static int8_t applyNumberOperator(uint8_t symbol, value_t *value1, value_t *value2) {
+    if (!valueIsNumber(value1) || !valueIsNumber(value2)) {
+        errorMessage = ERROR_MESSAGE_BAD_OPERAND_TYPE;
+        return false;
     }
-    status->code = tempResult2.nextCode;
-    float tempOperand1Float = *(float *)&(status->result.value.data);
-    float tempOperand2Float = *(float *)&(tempResult2.value.data);
-    int32_t tempOperand1Int = (int32_t)tempOperand1Float;
-    int32_t tempOperand2Int = (int32_t)tempOperand2Float;
-    if (status->symbol >= SYMBOL_ADD_ASSIGN && status->symbol <= SYMBOL_BITSHIFT_RIGHT_ASSIGN) {
-        if (status->result.destination == NULL) {
-            reportError(ERROR_MESSAGE_BAD_DESTINATION, status->startCode);
-            status->result.status = EVALUATION_STATUS_QUIT;
-            return;
-        } else {
-            int8_t tempType;
-            float tempNumber;
-            if (status->result.destinationType == DESTINATION_TYPE_VALUE) {
-                tempType = ((value_t *)(status->result.destination))->type;
-                if (tempType == VALUE_TYPE_NUMBER) {
-                    tempNumber = *(float *)(((value_t *)(status->result.destination))->data);
-                }
-            }
-            if (status->result.destinationType == DESTINATION_TYPE_SYMBOL) {
-                tempType = VALUE_TYPE_NUMBER;
-                tempNumber = *(uint8_t *)(status->result.destination);
-            }
-            if (status->symbol == SYMBOL_ADD_ASSIGN) {
-                if (tempType == VALUE_TYPE_NUMBER) {
-                    if (tempResult2.value.type != VALUE_TYPE_NUMBER) {
-                        reportError(ERROR_MESSAGE_BAD_OPERAND_TYPE, status->startCode);
-                        status->result.status = EVALUATION_STATUS_QUIT;
-                        return;
-                    }
-                    tempNumber += tempOperand2Float;
-                } else if (tempType == VALUE_TYPE_STRING) {
-                    if (tempResult2.value.type != VALUE_TYPE_STRING) {
-                        reportError(ERROR_MESSAGE_BAD_OPERAND_TYPE, status->startCode);
-                        status->result.status = EVALUATION_STATUS_QUIT;
-                        return;
-                    }
-                    int8_t *tempPointer = *(int8_t **)(((value_t *)(status->result.destination))->data);
-                    int8_t *tempString = *(int8_t **)tempPointer;
-                    int16_t tempLength = *(int16_t *)(tempString + STRING_LENGTH_OFFSET);
-                    int8_t tempResult3 = insertSubsequenceIntoSequence((value_t *)(status->result.destination), tempLength, &(tempResult2.value));
-                    if (!tempResult3) {
-                        errorCode = status->startCode;
-                        status->result.status = EVALUATION_STATUS_QUIT;
-                        return;
-                    }
-                } else {
-                    reportError(ERROR_MESSAGE_BAD_OPERAND_TYPE, status->startCode);
-                    status->result.status = EVALUATION_STATUS_QUIT;
-                    return;
-                }
-            } else if (tempType != VALUE_TYPE_NUMBER || tempResult2.value.type != VALUE_TYPE_NUMBER) {
-                reportError(ERROR_MESSAGE_BAD_OPERAND_TYPE, status->startCode);
-                status->result.status = EVALUATION_STATUS_QUIT;
-                return;
-            }
-            if (status->symbol == SYMBOL_SUBTRACT_ASSIGN) {
-                tempNumber -= tempOperand2Float;
-            }
-            if (status->symbol == SYMBOL_MULTIPLY_ASSIGN) {
-                tempNumber *= tempOperand2Float;
-            }
-            if (status->symbol == SYMBOL_DIVIDE_ASSIGN) {
-                if (tempOperand2Float == 0.0) {
-                    reportError(ERROR_MESSAGE_DIVIDE_BY_ZERO, status->startCode);
-                    status->result.status = EVALUATION_STATUS_QUIT;
-                    return;
-                }
-                tempNumber /= tempOperand2Float;
-            }
-            if (status->symbol == SYMBOL_MODULUS_ASSIGN) {
-                if (tempOperand2Float == 0.0) {
-                    reportError(ERROR_MESSAGE_DIVIDE_BY_ZERO, status->startCode);
-                    status->result.status = EVALUATION_STATUS_QUIT;
-                    return;
-                }
-                tempNumber = tempOperand1Int % tempOperand2Int;
-            }
-            if (status->symbol == SYMBOL_BOOLEAN_AND_ASSIGN) {
-                tempNumber = ((tempOperand1Float != 0.0) & (tempOperand2Float != 0.0));
-            }
-            if (status->symbol == SYMBOL_BOOLEAN_OR_ASSIGN) {
-                tempNumber = ((tempOperand1Float != 0.0) | (tempOperand2Float != 0.0));
-            }
-            if (status->symbol == SYMBOL_BOOLEAN_XOR_ASSIGN) {
-                tempNumber = ((tempOperand1Float != 0.0) ^ (tempOperand2Float != 0.0));
-            }
-            if (status->symbol == SYMBOL_BITWISE_AND_ASSIGN) {
-                tempNumber = (tempOperand1Int & tempOperand2Int);
-            }
-            if (status->symbol == SYMBOL_BITWISE_OR_ASSIGN) {
-                tempNumber = (tempOperand1Int | tempOperand2Int);
-            }
-            if (status->symbol == SYMBOL_BITWISE_XOR_ASSIGN) {
-                tempNumber = (tempOperand1Int ^ tempOperand2Int);
-            }
-            if (status->symbol == SYMBOL_BITSHIFT_LEFT_ASSIGN) {
-                tempNumber = (tempOperand1Int << tempOperand2Int);
-            }
-            if (status->symbol == SYMBOL_BITSHIFT_RIGHT_ASSIGN) {
-                tempNumber = (tempOperand1Int >> tempOperand2Int);
-            }
-            if (tempType == VALUE_TYPE_NUMBER) {
-                if (status->result.destinationType == DESTINATION_TYPE_VALUE) {
-                    *(float *)(((value_t *)(status->result.destination))->data) = tempNumber;
-                }
-                if (status->result.destinationType == DESTINATION_TYPE_SYMBOL) {
-                    *(uint8_t *)(status->result.destination) = tempNumber;
-                }
-            }
+    int32_t tempInteger1 = getNumberValueInteger(value1);
+    int32_t tempInteger2 = getNumberValueInteger(value2);
+    int32_t tempResult;
+    int8_t tempIsInteger = true;
+    if (symbol == '%') {
+        if (tempInteger2 == 0) {
+            errorMessage = ERROR_MESSAGE_DIVIDE_BY_ZERO;
+            return false;
         }
-    } else {
-        if (status->symbol != '=') {
-            if (status->result.value.type == VALUE_TYPE_MISSING) {
-                reportError(ERROR_MESSAGE_MISSING_VALUE, status->startCode);
-                status->result.status = EVALUATION_STATUS_QUIT;
-                return;
-            }
+        tempResult = tempInteger1 % tempInteger2;
+    } else if (symbol == '&') {
+        tempResult = (tempInteger1 & tempInteger2);
+    } else if (symbol == '|') {
+        tempResult = (tempInteger1 | tempInteger2);
+    } else if (symbol == '^') {
+        tempResult = (tempInteger1 ^ tempInteger2);
+    } else if (symbol == SYMBOL_BITSHIFT_LEFT) {
+        // Checked like *, so that a result which does not fit turns
+        // into a number on the device and in the emulator alike.
+        tempIsInteger = (tempInteger2 >= 0 && tempInteger2 < 31
+            && !__builtin_mul_overflow(tempInteger1, (int32_t)1 << tempInteger2, &tempResult)
+            && integerFits(tempResult));
+    } else if (symbol == SYMBOL_BITSHIFT_RIGHT) {
+        tempResult = (tempInteger1 >> tempInteger2);
+    } else if (value1->type != VALUE_TYPE_INTEGER || value2->type != VALUE_TYPE_INTEGER) {
+        tempIsInteger = false;
+    } else if (symbol == '+') {
+        tempIsInteger = (!__builtin_add_overflow(tempInteger1, tempInteger2, &tempResult) && integerFits(tempResult));
+    } else if (symbol == '-') {
+        tempIsInteger = (!__builtin_sub_overflow(tempInteger1, tempInteger2, &tempResult) && integerFits(tempResult));
+    } else if (symbol == '*') {
+        tempIsInteger = (!__builtin_mul_overflow(tempInteger1, tempInteger2, &tempResult) && integerFits(tempResult));
+    } else if (symbol == '/') {
+        if (tempInteger2 == 0) {
+            errorMessage = ERROR_MESSAGE_DIVIDE_BY_ZERO;
+            return false;
         }
-        if (status->symbol == '+') {
-            if (status->result.value.type == VALUE_TYPE_NUMBER) {
-                if (tempResult2.value.type != VALUE_TYPE_NUMBER) {
-                    reportError(ERROR_MESSAGE_BAD_OPERAND_TYPE, status->startCode);
-                    status->result.status = EVALUATION_STATUS_QUIT;
-                    return;
-                }
-                *(float *)&(status->result.value.data) += tempOperand2Float;
-            } else if (status->result.value.type == VALUE_TYPE_STRING) {
-                if (tempResult2.value.type != VALUE_TYPE_STRING) {
-                    reportError(ERROR_MESSAGE_BAD_OPERAND_TYPE, status->startCode);
-                    status->result.status = EVALUATION_STATUS_QUIT;
-                    return;
-                }
-                int8_t *tempPointer1 = *(int8_t **)(status->result.value.data);
-                int8_t *tempPointer2 = *(int8_t **)(tempResult2.value.data);
-                int8_t *tempString1 = *(int8_t **)tempPointer1;
-                int8_t *tempString2 = *(int8_t **)tempPointer2;
-                int16_t tempLength1 = *(int16_t *)(tempString1 + STRING_LENGTH_OFFSET);
-                int16_t tempLength2 = *(int16_t *)(tempString2 + STRING_LENGTH_OFFSET);
-                int8_t *tempPointer3 = createEmptyString(tempLength1 + tempLength2);
-                if (tempPointer3 == NULL) {
-                    reportError(ERROR_MESSAGE_STACK_HEAP_COLLISION, status->startCode);
-                    status->result.status = EVALUATION_STATUS_QUIT;
-                    return;
-                }
-                int8_t *tempString3 = *(int8_t **)tempPointer3;
-                memcpy(tempString3 + STRING_DATA_OFFSET, tempString1 + STRING_DATA_OFFSET, tempLength1);
-                memcpy(tempString3 + STRING_DATA_OFFSET + tempLength1, tempString2 + STRING_DATA_OFFSET, tempLength2 + 1);
-                *(int8_t **)&(status->result.value.data) = tempPointer3;
-            } else {
-                reportError(ERROR_MESSAGE_BAD_OPERAND_TYPE, status->startCode);
-                status->result.status = EVALUATION_STATUS_QUIT;
-                return;
+        if (tempInteger2 == -1) {
+            tempIsInteger = (!__builtin_sub_overflow(0, tempInteger1, &tempResult) && integerFits(tempResult));
+        } else {
+            tempResult = tempInteger1 / tempInteger2;
+            tempIsInteger = (tempResult * tempInteger2 == tempInteger1);
+        }
+    } else if (symbol == SYMBOL_BOOLEAN_AND) {
+        tempResult = ((tempInteger1 != 0) & (tempInteger2 != 0));
+    } else if (symbol == SYMBOL_BOOLEAN_OR) {
+        tempResult = ((tempInteger1 != 0) | (tempInteger2 != 0));
+    } else if (symbol == SYMBOL_BOOLEAN_XOR) {
+        tempResult = ((tempInteger1 != 0) ^ (tempInteger2 != 0));
+    } else if (symbol == SYMBOL_EQUAL) {
+        tempResult = (tempInteger1 == tempInteger2);
+    } else if (symbol == SYMBOL_NOT_EQUAL) {
+        tempResult = (tempInteger1 != tempInteger2);
+    } else if (symbol == '>') {
+        tempResult = (tempInteger1 > tempInteger2);
+    } else if (symbol == '<') {
+        tempResult = (tempInteger1 < tempInteger2);
+    } else if (symbol == SYMBOL_GREATER_OR_EQUAL) {
+        tempResult = (tempInteger1 >= tempInteger2);
+    } else {
+        tempResult = (tempInteger1 <= tempInteger2);
+    }
+    if (!tempIsInteger) {
+        float tempNumber1 = getNumberValueFloat(value1);
+        float tempNumber2 = getNumberValueFloat(value2);
+        float tempNumber;
+        if (symbol == '+') {
+            tempNumber = tempNumber1 + tempNumber2;
+        } else if (symbol == '-') {
+            tempNumber = tempNumber1 - tempNumber2;
+        } else if (symbol == '*') {
+            tempNumber = tempNumber1 * tempNumber2;
+        } else if (symbol == '/') {
+            if (tempNumber2 == 0.0) {
+                errorMessage = ERROR_MESSAGE_DIVIDE_BY_ZERO;
+                return false;
             }
-        } else if (status->symbol == SYMBOL_EQUAL) {
-            if (status->result.value.type == VALUE_TYPE_NUMBER) {
-                if (tempResult2.value.type != VALUE_TYPE_NUMBER) {
-                    reportError(ERROR_MESSAGE_BAD_OPERAND_TYPE, status->startCode);
-                    status->result.status = EVALUATION_STATUS_QUIT;
-                    return;
-                }
-                *(float *)&(status->result.value.data) = (tempOperand1Float == tempOperand2Float);
-            } else if (status->result.value.type == VALUE_TYPE_STRING) {
-                if (tempResult2.value.type != VALUE_TYPE_STRING) {
-                    reportError(ERROR_MESSAGE_BAD_OPERAND_TYPE, status->startCode);
-                    status->result.status = EVALUATION_STATUS_QUIT;
-                    return;
-                }
-                int8_t *tempPointer1 = *(int8_t **)(status->result.value.data);
-                int8_t *tempPointer2 = *(int8_t **)(tempResult2.value.data);
-                status->result.value.type = VALUE_TYPE_NUMBER;
-                *(float *)&(status->result.value.data) = stringsAreEqual(tempPointer1, tempPointer2);
+            tempNumber = tempNumber1 / tempNumber2;
+        } else if (symbol == SYMBOL_BITSHIFT_LEFT) {
+            tempNumber = ldexp(tempInteger1, tempInteger2);
+        } else {
+            // Comparisons and boolean operators always give integers.
+            if (symbol == SYMBOL_BOOLEAN_AND) {
+                tempResult = ((tempNumber1 != 0.0) & (tempNumber2 != 0.0));
+            } else if (symbol == SYMBOL_BOOLEAN_OR) {
+                tempResult = ((tempNumber1 != 0.0) | (tempNumber2 != 0.0));
+            } else if (symbol == SYMBOL_BOOLEAN_XOR) {
+                tempResult = ((tempNumber1 != 0.0) ^ (tempNumber2 != 0.0));
+            } else if (symbol == SYMBOL_EQUAL) {
+                tempResult = (tempNumber1 == tempNumber2);
+            } else if (symbol == SYMBOL_NOT_EQUAL) {
+                tempResult = (tempNumber1 != tempNumber2);
+            } else if (symbol == '>') {
+                tempResult = (tempNumber1 > tempNumber2);
+            } else if (symbol == '<') {
+                tempResult = (tempNumber1 < tempNumber2);
+            } else if (symbol == SYMBOL_GREATER_OR_EQUAL) {
+                tempResult = (tempNumber1 >= tempNumber2);
             } else {
-                reportError(ERROR_MESSAGE_BAD_OPERAND_TYPE, status->startCode);
-                status->result.status = EVALUATION_STATUS_QUIT;
-                return;
+                tempResult = (tempNumber1 <= tempNumber2);
             }
-        } else if (status->symbol == SYMBOL_NOT_EQUAL) {
-            if (status->result.value.type == VALUE_TYPE_NUMBER) {
-                if (tempResult2.value.type != VALUE_TYPE_NUMBER) {
-                    reportError(ERROR_MESSAGE_BAD_OPERAND_TYPE, status->startCode);
-                    status->result.status = EVALUATION_STATUS_QUIT;
-                    return;
-                }
-                *(float *)&(status->result.value.data) = (tempOperand1Float != tempOperand2Float);
-            } else if (status->result.value.type == VALUE_TYPE_STRING) {
-                if (tempResult2.value.type != VALUE_TYPE_STRING) {
-                    reportError(ERROR_MESSAGE_BAD_OPERAND_TYPE, status->startCode);
-                    status->result.status = EVALUATION_STATUS_QUIT;
-                    return;
-                }
-                int8_t *tempPointer1 = *(int8_t **)(status->result.value.data);
-                int8_t *tempPointer2 = *(int8_t **)(tempResult2.value.data);
-                status->result.value.type = VALUE_TYPE_NUMBER;
-                *(float *)&(status->result.value.data) = !stringsAreEqual(tempPointer1, tempPointer2);
-            } else {
-                reportError(ERROR_MESSAGE_BAD_OPERAND_TYPE, status->startCode);
-                status->result.status = EVALUATION_STATUS_QUIT;
-                return;
-            }
-        } else if (status->symbol == '=') {
-            if (status->result.destination == NULL) {
-                volatile int16_t tempCheatSize = VARIABLE_NAME_MAXIMUM_LENGTH + 1;
-                uint8_t tempBuffer[tempCheatSize];
-                int32_t tempCode = readStorageVariableName(tempBuffer, status->startCode);
-                if (tempCode < 0) {
-                    errorCode = status->startCode;
-                    status->result.status = EVALUATION_STATUS_QUIT;
-                    return;
-                }
-                status->result.destinationType = DESTINATION_TYPE_VALUE;
-                value_t *tempValue = createVariable(tempBuffer);
-                if (tempValue == NULL) {
-                    reportError(ERROR_MESSAGE_STACK_HEAP_COLLISION, status->startCode);
-                    status->result.status = EVALUATION_STATUS_QUIT;
-                    return;
-                }
-                *(value_t **)&(status->result.destination) = tempValue;
-            }
-            if (status->result.destinationType == DESTINATION_TYPE_VALUE) {
-                *(value_t *)(status->result.destination) = tempResult2.value;
-            }
-            if (status->result.destinationType == DESTINATION_TYPE_SYMBOL) {
-                if (tempResult2.value.type != VALUE_TYPE_NUMBER) {
-                    reportError(ERROR_MESSAGE_BAD_OPERAND_TYPE, status->startCode);
-                    status->result.status = EVALUATION_STATUS_QUIT;
-                    return;
-                }
-                *(uint8_t *)(status->result.destination) = *(float *)(tempResult2.value.data);
-            }
-        } else if (status->result.value.type != VALUE_TYPE_NUMBER || tempResult2.value.type != VALUE_TYPE_NUMBER) {
-            reportError(ERROR_MESSAGE_BAD_OPERAND_TYPE, status->startCode);
+            tempIsInteger = true;
+        }
+        if (!tempIsInteger) {
+            value1->type = VALUE_TYPE_NUMBER;
+            *(float *)(value1->data) = tempNumber;
+            return true;
+        }
+    }
+    value1->type = VALUE_TYPE_INTEGER;
+    *(int32_t *)(value1->data) = tempResult;
+    return true;
+}
+
+// Adds amount to the number at a destination for ++ and --.
+static void addToNumberDestination(int8_t *destination, int8_t destinationType, int8_t amount) {
+    if (destinationType == DESTINATION_TYPE_VALUE) {
+        value_t tempAmount;
+        tempAmount.type = VALUE_TYPE_INTEGER;
+        *(int32_t *)(tempAmount.data) = amount;
+        applyNumberOperator('+', (value_t *)destination, &tempAmount);
+    }
+    if (destinationType == DESTINATION_TYPE_SYMBOL) {
+        *(uint8_t *)destination += amount;
+    }
+}
+
+static void __attribute__ ((noinline)) evaluateBinaryOperatorExpression1(expressionStatus_t *status, int8_t index, int8_t precedence) {
+    status->code += 1;
+    expressionResult_t tempResult2 = evaluateExpression(status->code, precedence, false);
+    firstTreasureTracker = &status->treasureTracker;
+    treasureTracker_t tempTreasureTracker2;
+    initializeTreasureTracker(&tempTreasureTracker2, TREASURE_TYPE_VALUE, &(tempResult2.value));
+    if (tempResult2.status != EVALUATION_STATUS_NORMAL) {
+        status->result.status = tempResult2.status;
+        return;
+    }
+    if (tempResult2.value.type == VALUE_TYPE_MISSING) {
+        reportError(ERROR_MESSAGE_MISSING_VALUE, status->startCode);
+        status->result.status = EVALUATION_STATUS_QUIT;
+        return;
+    }
+    status->code = tempResult2.nextCode;
+    if (status->symbol >= SYMBOL_ADD_ASSIGN && status->symbol <= SYMBOL_BITSHIFT_RIGHT_ASSIGN) {
+        if (status->result.destination == NULL || status->result.destinationType == DESTINATION_TYPE_READ_ONLY) {
+            reportError(ERROR_MESSAGE_BAD_DESTINATION, status->startCode);
             status->result.status = EVALUATION_STATUS_QUIT;
             return;
         }
-        if (status->symbol == '-') {
-            *(float *)&(status->result.value.data) -= tempOperand2Float;
+        value_t tempValue;
+        if (status->result.destinationType == DESTINATION_TYPE_VALUE) {
+            tempValue = *(value_t *)(status->result.destination);
         }
-        if (status->symbol == '*') {
-            *(float *)&(status->result.value.data) *= tempOperand2Float;
+        if (status->result.destinationType == DESTINATION_TYPE_SYMBOL) {
+            tempValue.type = VALUE_TYPE_INTEGER;
+            *(int32_t *)(tempValue.data) = *(uint8_t *)(status->result.destination);
         }
-        if (status->symbol == '/') {
-            if (tempOperand2Float == 0.0) {
-                reportError(ERROR_MESSAGE_DIVIDE_BY_ZERO, status->startCode);
+        if (status->symbol == SYMBOL_ADD_ASSIGN && tempValue.type == VALUE_TYPE_STRING) {
+            if (!convertViewToString(&(tempResult2.value))) {
+                reportError(errorMessage, status->startCode);
                 status->result.status = EVALUATION_STATUS_QUIT;
                 return;
             }
-            *(float *)&(status->result.value.data) /= tempOperand2Float;
-        }
-        if (status->symbol == '%') {
-            if (tempOperand2Int == 0) {
-                reportError(ERROR_MESSAGE_DIVIDE_BY_ZERO, status->startCode);
+            if (tempResult2.value.type != VALUE_TYPE_STRING) {
+                reportError(ERROR_MESSAGE_BAD_OPERAND_TYPE, status->startCode);
                 status->result.status = EVALUATION_STATUS_QUIT;
                 return;
             }
-            *(float *)&(status->result.value.data) = tempOperand1Int % tempOperand2Int;
+            int8_t *tempPointer = *(int8_t **)(tempValue.data);
+            int8_t *tempString = *(int8_t **)tempPointer;
+            int16_t tempLength = *(int16_t *)(tempString + STRING_LENGTH_OFFSET);
+            int8_t tempResult3 = insertSubsequenceIntoSequence((value_t *)(status->result.destination), tempLength, &(tempResult2.value));
+            if (!tempResult3) {
+                errorCode = status->startCode;
+                status->result.status = EVALUATION_STATUS_QUIT;
+                return;
+            }
+            return;
+        }
+        uint8_t tempSymbol = pgm_read_byte(ASSIGNMENT_OPERATOR_LIST + (status->symbol - SYMBOL_ADD_ASSIGN));
+        if (!applyNumberOperator(tempSymbol, &tempValue, &(tempResult2.value))) {
+            reportError(errorMessage, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
         }
-        if (status->symbol == SYMBOL_BOOLEAN_AND) {
-            *(float *)&(status->result.value.data) = ((tempOperand1Float != 0.0) & (tempOperand2Float != 0.0));
+        if (status->result.destinationType == DESTINATION_TYPE_VALUE) {
+            *(value_t *)(status->result.destination) = tempValue;
         }
-        if (status->symbol == SYMBOL_BOOLEAN_OR) {
-            *(float *)&(status->result.value.data) = ((tempOperand1Float != 0.0) | (tempOperand2Float != 0.0));
+        if (status->result.destinationType == DESTINATION_TYPE_SYMBOL) {
+            *(uint8_t *)(status->result.destination) = getNumberValueInteger(&tempValue);
         }
-        if (status->symbol == SYMBOL_BOOLEAN_XOR) {
-            *(float *)&(status->result.value.data) = ((tempOperand1Float != 0.0) ^ (tempOperand2Float != 0.0));
+        return;
+    }
+    if (status->symbol != '=') {
+        if (status->result.value.type == VALUE_TYPE_MISSING) {
+            reportError(ERROR_MESSAGE_MISSING_VALUE, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
         }
-        if (status->symbol == '&') {
-            *(float *)&(status->result.value.data) = (tempOperand1Int & tempOperand2Int);
+    }
+    if (status->symbol == '+' && (status->result.value.type == VALUE_TYPE_STRING || status->result.value.type == VALUE_TYPE_VIEW)) {
+        if (tempResult2.value.type != VALUE_TYPE_STRING && tempResult2.value.type != VALUE_TYPE_VIEW) {
+            reportError(ERROR_MESSAGE_BAD_OPERAND_TYPE, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
         }
-        if (status->symbol == '|') {
-            *(float *)&(status->result.value.data) = (tempOperand1Int | tempOperand2Int);
+        if (!convertViewToString(&(status->result.value)) || !convertViewToString(&(tempResult2.value))) {
+            reportError(errorMessage, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
         }
-        if (status->symbol == '^') {
-            *(float *)&(status->result.value.data) = (tempOperand1Int ^ tempOperand2Int);
+        int8_t *tempPointer1 = *(int8_t **)(status->result.value.data);
+        int8_t *tempPointer2 = *(int8_t **)(tempResult2.value.data);
+        int8_t *tempString1 = *(int8_t **)tempPointer1;
+        int8_t *tempString2 = *(int8_t **)tempPointer2;
+        int16_t tempLength1 = *(int16_t *)(tempString1 + STRING_LENGTH_OFFSET);
+        int16_t tempLength2 = *(int16_t *)(tempString2 + STRING_LENGTH_OFFSET);
+        int8_t *tempPointer3 = createEmptyString(tempLength1 + tempLength2);
+        if (tempPointer3 == NULL) {
+            reportError(ERROR_MESSAGE_STACK_HEAP_COLLISION, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
         }
-        if (status->symbol == SYMBOL_BITSHIFT_LEFT) {
-            *(float *)&(status->result.value.data) = (tempOperand1Int << tempOperand2Int);
+        int8_t *tempString3 = *(int8_t **)tempPointer3;
+        memcpy(tempString3 + STRING_DATA_OFFSET, tempString1 + STRING_DATA_OFFSET, tempLength1);
+        memcpy(tempString3 + STRING_DATA_OFFSET + tempLength1, tempString2 + STRING_DATA_OFFSET, tempLength2 + 1);
+        *(int8_t **)&(status->result.value.data) = tempPointer3;
+    } else if ((status->symbol == SYMBOL_EQUAL || status->symbol == SYMBOL_NOT_EQUAL)
+            && (status->result.value.type == VALUE_TYPE_STRING || status->result.value.type == VALUE_TYPE_VIEW)) {
+        if (tempResult2.value.type != VALUE_TYPE_STRING && tempResult2.value.type != VALUE_TYPE_VIEW) {
+            reportError(ERROR_MESSAGE_BAD_OPERAND_TYPE, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
         }
-        if (status->symbol == SYMBOL_BITSHIFT_RIGHT) {
-            *(float *)&(status->result.value.data) = (tempOperand1Int >> tempOperand2Int);
+        int8_t tempIsEqual = textValuesAreEqual(&(status->result.value), &(tempResult2.value));
+        if (tempIsEqual < 0) {
+            reportError(errorMessage, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
         }
-        if (status->symbol == '>') {
-            *(float *)&(status->result.value.data) = tempOperand1Float > tempOperand2Float;
+        status->result.value.type = VALUE_TYPE_INTEGER;
+        *(int32_t *)&(status->result.value.data) = (tempIsEqual == (status->symbol == SYMBOL_EQUAL));
+    } else if (status->symbol == '=') {
+        if (status->result.destination != NULL && status->result.destinationType == DESTINATION_TYPE_READ_ONLY) {
+            reportError(ERROR_MESSAGE_BAD_DESTINATION, status->startCode);
+            status->result.status = EVALUATION_STATUS_QUIT;
+            return;
         }
-        if (status->symbol == '<') {
-            *(float *)&(status->result.value.data) = tempOperand1Float < tempOperand2Float;
+        if (status->result.destination == NULL) {
+            volatile int16_t tempCheatSize = VARIABLE_NAME_MAXIMUM_LENGTH + 1;
+            uint8_t tempBuffer[tempCheatSize];
+            uint8_t tempHash;
+            int32_t tempCode = readStorageVariableName(tempBuffer, status->startCode, &tempHash);
+            if (tempCode < 0) {
+                errorCode = status->startCode;
+                status->result.status = EVALUATION_STATUS_QUIT;
+                return;
+            }
+            status->result.destinationType = DESTINATION_TYPE_VALUE;
+            value_t *tempValue = createVariable(tempBuffer, tempHash);
+            if (tempValue == NULL) {
+                reportError(ERROR_MESSAGE_STACK_HEAP_COLLISION, status->startCode);
+                status->result.status = EVALUATION_STATUS_QUIT;
+                return;
+            }
+            *(value_t **)&(status->result.destination) = tempValue;
         }
-        if (status->symbol == SYMBOL_GREATER_OR_EQUAL) {
-            *(float *)&(status->result.value.data) = tempOperand1Float >= tempOperand2Float;
+        if (status->result.destinationType == DESTINATION_TYPE_VALUE) {
+            *(value_t *)(status->result.destination) = tempResult2.value;
         }
-        if (status->symbol == SYMBOL_LESS_OR_EQUAL) {
-            *(float *)&(status->result.value.data) = tempOperand1Float <= tempOperand2Float;
+        if (status->result.destinationType == DESTINATION_TYPE_SYMBOL) {
+            if (!valueIsNumber(&(tempResult2.value))) {
+                reportError(ERROR_MESSAGE_BAD_OPERAND_TYPE, status->startCode);
+                status->result.status = EVALUATION_STATUS_QUIT;
+                return;
+            }
+            *(uint8_t *)(status->result.destination) = getNumberValueInteger(&(tempResult2.value));
         }
+    } else if (!applyNumberOperator(status->symbol, &(status->result.value), &(tempResult2.value))) {
+        reportError(errorMessage, status->startCode);
+        status->result.status = EVALUATION_STATUS_QUIT;
+        return;
     }
 }
 
@@ -3483,70 +5468,66 @@ static void __attribute__ ((noinline)) evaluateUnaryOperatorExpression(expressio
         return;
     }
     status->code = tempResult2.nextCode;
-    if (tempResult2.value.type != VALUE_TYPE_NUMBER) {
+    if (!valueIsNumber(&(tempResult2.value))) {
         reportError(ERROR_MESSAGE_BAD_OPERAND_TYPE, status->startCode);
         status->result.status = EVALUATION_STATUS_QUIT;
         return;
     }
     if (status->symbol == '-') {
-        status->result.value.type = VALUE_TYPE_NUMBER;
-        *(float *)&(status->result.value.data) = -(*(float *)&(tempResult2.value.data));
+        int32_t tempInteger;
+        if (tempResult2.value.type == VALUE_TYPE_INTEGER
+                && !__builtin_sub_overflow(0, *(int32_t *)&(tempResult2.value.data), &tempInteger)
+                && integerFits(tempInteger)) {
+            status->result.value.type = VALUE_TYPE_INTEGER;
+            *(int32_t *)&(status->result.value.data) = tempInteger;
+        } else {
+            status->result.value.type = VALUE_TYPE_NUMBER;
+            *(float *)&(status->result.value.data) = -getNumberValueFloat(&(tempResult2.value));
+        }
     }
     if (status->symbol == '!') {
-        status->result.value.type = VALUE_TYPE_NUMBER;
-        *(float *)&(status->result.value.data) = (*(float *)&(tempResult2.value.data) == 0.0);
+        status->result.value.type = VALUE_TYPE_INTEGER;
+        *(int32_t *)&(status->result.value.data) = numberValueIsZero(&(tempResult2.value));
     }
     if (status->symbol == '~') {
-        status->result.value.type = VALUE_TYPE_NUMBER;
-        *(float *)&(status->result.value.data) = ~(int32_t)*(float *)&(tempResult2.value.data);
-    }
-    if (status->symbol == SYMBOL_INCREMENT) {
-        if (tempResult2.destination == NULL) {
-            reportError(ERROR_MESSAGE_BAD_DESTINATION, status->startCode);
-            status->result.status = EVALUATION_STATUS_QUIT;
-            return;
-        }
-        status->result.destinationType = tempResult2.destinationType;
-        status->result.destination = tempResult2.destination;
-        if (tempResult2.destinationType == DESTINATION_TYPE_VALUE) {
-            *(float *)(((value_t *)(status->result.destination))->data) += 1.0;
-            status->result.value.type = VALUE_TYPE_NUMBER;
-            status->result.value = *(value_t *)(status->result.destination);
-        }
-        if (tempResult2.destinationType == DESTINATION_TYPE_SYMBOL) {
-            *(uint8_t *)(status->result.destination) += 1; 
-            status->result.value.type = VALUE_TYPE_NUMBER;
-            *(float *)(status->result.value.data) = *(uint8_t *)(status->result.destination);
-        }
+        status->result.value.type = VALUE_TYPE_INTEGER;
+        *(int32_t *)&(status->result.value.data) = ~getNumberValueInteger(&(tempResult2.value));
     }
-    if (status->symbol == SYMBOL_DECREMENT) {
-        if (tempResult2.destination == NULL) {
+    if (status->symbol == SYMBOL_INCREMENT || status->symbol == SYMBOL_DECREMENT) {
+        if (tempResult2.destination == NULL || tempResult2.destinationType == DESTINATION_TYPE_READ_ONLY) {
             reportError(ERROR_MESSAGE_BAD_DESTINATION, status->startCode);
             status->result.status = EVALUATION_STATUS_QUIT;
             return;
         }
         status->result.destinationType = tempResult2.destinationType;
         status->result.destination = tempResult2.destination;
+        addToNumberDestination(status->result.destination, status->result.destinationType, (status->symbol == SYMBOL_INCREMENT) ? 1 : -1);
         if (tempResult2.destinationType == DESTINATION_TYPE_VALUE) {
-            *(float *)(((value_t *)(status->result.destination))->data) -= 1.0;
-            status->result.value.type = VALUE_TYPE_NUMBER;
             status->result.value = *(value_t *)(status->result.destination);
         }
         if (tempResult2.destinationType == DESTINATION_TYPE_SYMBOL) {
-            *(uint8_t *)(status->result.destination) -= 1; 
-            status->result.value.type = VALUE_TYPE_NUMBER;
-            *(float *)(status->result.value.data) = *(uint8_t *)(status->result.destination);
+            status->result.value.type = VALUE_TYPE_INTEGER;
+            *(int32_t *)(status->result.value.data) = *(uint8_t *)(status->result.destination);
         }
     }
 }
 
 static int8_t __attribute__ ((noinline)) evaluateLiteralExpression(expressionStatus_t *status) {
     if ((status->symbol >= '0' && status->symbol <= '9') || status->symbol == '.') {
+        #if NUMBER_LITERAL_CACHE_SIZE > 0
+            int8_t tempSlot = getNumberLiteralCacheSlot(status->code);
+            if (numberLiteralCacheAddressList[tempSlot] == status->code) {
+                status->code += numberLiteralCacheLengthList[tempSlot];
+                status->result.value = numberLiteralCacheValueList[tempSlot];
+                return true;
+            }
+        #endif
         volatile int16_t tempCheatSize = NUMBER_LITERAL_MAXIMUM_LENGTH + 1;
         uint8_t tempBuffer[tempCheatSize];
         tempBuffer[0] = status->symbol;
         status->code += 1;
         uint8_t tempLastSymbol = 0;
+        int8_t tempIsInteger = (status->symbol != '.');
         int8_t index = 1;
         while (true) {
             if (index >= NUMBER_LITERAL_MAXIMUM_LENGTH) {
@@ -3560,27 +5541,60 @@ static int8_t __attribute__ ((noinline)) evaluateLiteralExpression(expressionSta
                 tempBuffer[index] = 0;
                 break;
             }
+            if (tempSymbol == '.' || tempSymbol == 'e') {
+                tempIsInteger = false;
+            }
             tempBuffer[index] = tempSymbol;
             tempLastSymbol = tempSymbol;
             status->code += 1;
             index += 1;
         }
-        status->result.value.type = VALUE_TYPE_NUMBER;
-        float tempNumber = convertTextToFloat(tempBuffer);
-        *(float *)(status->result.value.data) = tempNumber;
+        // Nine digits always fit in int32_t.
+        if (tempIsInteger && index <= 9) {
+            status->result.value.type = VALUE_TYPE_INTEGER;
+            *(int32_t *)(status->result.value.data) = atol(tempBuffer);
+        } else {
+            status->result.value.type = VALUE_TYPE_NUMBER;
+            *(float *)(status->result.value.data) = convertTextToFloat(tempBuffer);
+        }
+        #if NUMBER_LITERAL_CACHE_SIZE > 0
+            numberLiteralCacheAddressList[tempSlot] = status->code - index;
+            numberLiteralCacheValueList[tempSlot] = status->result.value;
+            numberLiteralCacheLengthList[tempSlot] = index;
+        #endif
     } else if ((status->symbol >= 'A' && status->symbol <= 'Z') || status->symbol == '_') {
+        #if VARIABLE_CACHE_SIZE > 0
+            int32_t tempNameAddress = status->code;
+            int8_t tempSlot = getVariableCacheSlot(tempNameAddress);
+            if (variableCacheAddressList[tempSlot] == tempNameAddress
+                    && variableCacheScopeList[tempSlot] == variableCacheScope) {
+                value_t *tempValue = variableCacheValueList[tempSlot];
+                status->code += variableCacheLengthList[tempSlot];
+                status->result.destinationType = DESTINATION_TYPE_VALUE;
+                status->result.destination = (int8_t *)tempValue;
+                status->result.value = *tempValue;
+                return true;
+            }
+        #endif
         volatile int16_t tempCheatSize = VARIABLE_NAME_MAXIMUM_LENGTH + 1;
         uint8_t tempBuffer[tempCheatSize];
-        status->code = readStorageVariableName(tempBuffer, status->code);
+        uint8_t tempHash;
+        status->code = readStorageVariableName(tempBuffer, status->code, &tempHash);
         if (status->code < 0) {
             errorCode = status->startCode;
             status->result.status = EVALUATION_STATUS_QUIT;
             return true;
         }
         status->result.destinationType = DESTINATION_TYPE_VALUE;
-        status->result.destination = (int8_t *)findVariableValueByName(tempBuffer);
+        status->result.destination = (int8_t *)findVariableValueByName(tempBuffer, tempHash);
         if (status->result.destination != NULL) {
             status->result.value = *(value_t *)(status->result.destination);
+            #if VARIABLE_CACHE_SIZE > 0
+                variableCacheAddressList[tempSlot] = tempNameAddress;
+                variableCacheValueList[tempSlot] = (value_t *)(status->result.destination);
+                variableCacheLengthList[tempSlot] = status->code - tempNameAddress;
+                variableCacheScopeList[tempSlot] = variableCacheScope;
+            #endif
         }
     } else if (status->symbol == '\'') {
         status->code += 1;
@@ -3600,8 +5614,8 @@ static int8_t __attribute__ ((noinline)) evaluateLiteralExpression(expressionSta
             return true;
         }
         status->code += 1;
-        status->result.value.type = VALUE_TYPE_NUMBER;
-        *(float *)&(status->result.value.data) = tempSymbol;
+        status->result.value.type = VALUE_TYPE_INTEGER;
+        *(int32_t *)&(status->result.value.data) = tempSymbol;
     } else if (status->symbol == '"') {
         status->code += 1;
         int16_t tempLength = getStringLiteralLength(status->code);
@@ -3698,42 +5712,19 @@ static int8_t __attribute__ ((noinline)) evaluateLiteralExpression(expressionSta
 }
 
 static int8_t __attribute__ ((noinline)) evaluateBinaryOperatorExpression2(expressionStatus_t *status) {
-    if (status->symbol == SYMBOL_INCREMENT) {
-        status->code += 1;
-        if (status->result.value.type != VALUE_TYPE_NUMBER) {
-            reportError(ERROR_MESSAGE_BAD_OPERAND_TYPE, status->startCode);
-            status->result.status = EVALUATION_STATUS_QUIT;
-            return true;
-        }
-        if (status->result.destination == NULL) {
-            reportError(ERROR_MESSAGE_BAD_DESTINATION, status->startCode);
-            status->result.status = EVALUATION_STATUS_QUIT;
-            return true;
-        }
-        if (status->result.destinationType == DESTINATION_TYPE_VALUE) {
-            *(float *)(((value_t *)(status->result.destination))->data) += 1.0;
-        }
-        if (status->result.destinationType == DESTINATION_TYPE_SYMBOL) {
-            *(uint8_t *)(status->result.destination) += 1;
-        }
-    } else if (status->symbol == SYMBOL_DECREMENT) {
+    if (status->symbol == SYMBOL_INCREMENT || status->symbol == SYMBOL_DECREMENT) {
         status->code += 1;
-        if (status->result.value.type != VALUE_TYPE_NUMBER) {
+        if (!valueIsNumber(&(status->result.value))) {
             reportError(ERROR_MESSAGE_BAD_OPERAND_TYPE, status->startCode);
             status->result.status = EVALUATION_STATUS_QUIT;
             return true;
         }
-        if (status->result.destination == NULL) {
+        if (status->result.destination == NULL || status->result.destinationType == DESTINATION_TYPE_READ_ONLY) {
             reportError(ERROR_MESSAGE_BAD_DESTINATION, status->startCode);
             status->result.status = EVALUATION_STATUS_QUIT;
             return true;
         }
-        if (status->result.destinationType == DESTINATION_TYPE_VALUE) {
-            *(float *)(((value_t *)(status->result.destination))->data) -= 1.0;
-        }
-        if (status->result.destinationType == DESTINATION_TYPE_SYMBOL) {
-            *(uint8_t *)(status->result.destination) -= 1;
-        }
+        addToNumberDestination(status->result.destination, status->result.destinationType, (status->symbol == SYMBOL_INCREMENT) ? 1 : -1);
     } else if (status->symbol == '[') {
         status->code += 1;
         if (status->result.value.type == VALUE_TYPE_MISSING) {
@@ -3762,12 +5753,12 @@ static int8_t __attribute__ ((noinline)) evaluateBinaryOperatorExpression2(expre
             return true;
         }
         status->code += 1;
-        if (tempResult2.value.type != VALUE_TYPE_NUMBER) {
+        if (!valueIsNumber(&(tempResult2.value))) {
             reportError(ERROR_MESSAGE_BAD_OPERAND_TYPE, status->startCode);
             status->result.status = EVALUATION_STATUS_QUIT;
             return true;
         }
-        int16_t index = *(float *)(tempResult2.value.data);
+        int16_t index = getNumberValueInteger(&(tempResult2.value));
         if (status->result.value.type == VALUE_TYPE_LIST) {
             int8_t *tempPointer = *(int8_t **)(status->result.value.data);
             int8_t *tempList = *(int8_t **)tempPointer;
@@ -3793,8 +5784,26 @@ static int8_t __attribute__ ((noinline)) evaluateBinaryOperatorExpression2(expre
             uint8_t *tempSymbol = tempString + STRING_DATA_OFFSET + index;
             status->result.destinationType = DESTINATION_TYPE_SYMBOL;
             status->result.destination = tempSymbol;
-            status->result.value.type = VALUE_TYPE_NUMBER;
-            *(float *)(status->result.value.data) = *tempSymbol;
+            status->result.value.type = VALUE_TYPE_INTEGER;
+            *(int32_t *)(status->result.value.data) = *tempSymbol;
+        } else if (status->result.value.type == VALUE_TYPE_VIEW) {
+            int16_t tempLength = getTextValueLength(&(status->result.value));
+            if (tempLength < 0) {
+                reportError(errorMessage, status->startCode);
+                status->result.status = EVALUATION_STATUS_QUIT;
+                return true;
+            }
+            if (index < 0 || index >= tempLength) {
+                reportError(ERROR_MESSAGE_BAD_INDEX, status->startCode);
+                status->result.status = EVALUATION_STATUS_QUIT;
+                return true;
+            }
+            uint8_t tempSymbol;
+            readTextValue(&tempSymbol, &(status->result.value), index, 1);
+            status->result.destinationType = DESTINATION_TYPE_READ_ONLY;
+            status->result.destination = (int8_t *)&(status->result);
+            status->result.value.type = VALUE_TYPE_INTEGER;
+            *(int32_t *)(status->result.value.data) = tempSymbol;
         } else {
             reportError(ERROR_MESSAGE_BAD_OPERAND_TYPE, status->startCode);
             status->result.status = EVALUATION_STATUS_QUIT;
@@ -3816,6 +5825,10 @@ static int8_t __attribute__ ((noinline)) evaluateBinaryOperatorExpression2(expre
         treasureTracker_t tempTreasureTracker3;
         int8_t tempArgumentAmount = getCustomFunctionArgumentAmount(tempCode);
         int8_t *tempPreviousScope = localScope;
+        #if VARIABLE_CACHE_SIZE > 0
+            uint16_t tempPreviousCacheScope = variableCacheScope;
+            uint16_t tempPreviousCacheEpoch = variableCacheEpoch;
+        #endif
         {
             value_t tempArgumentList[tempArgumentAmount];
             status->argumentList = tempArgumentList;
@@ -3850,8 +5863,9 @@ static int8_t __attribute__ ((noinline)) evaluateBinaryOperatorExpression2(expre
             }
             int16_t tempSize = *(int16_t *)(localScope + SCOPE_SIZE_OFFSET);
             localScope += SCOPE_DATA_OFFSET + tempSize;
+            renewVariableCacheScope();
             *(int16_t *)(localScope + SCOPE_SIZE_OFFSET) = 0;
-            *(int8_t **)(localScope + SCOPE_VARIABLE_OFFSET) = NULL;
+            memset(localScope + SCOPE_VARIABLE_OFFSET, 0, SCOPE_BUCKET_AMOUNT * sizeof(int8_t *));
             *(branch_t **)(localScope + SCOPE_BRANCH_OFFSET) = NULL;
             int8_t tempSuccess = pushBranch(BRANCH_ACTION_RUN, 0);
             if (!tempSuccess) {
@@ -3882,7 +5896,7 @@ static int8_t __attribute__ ((noinline)) evaluateBinaryOperatorExpression2(expre
                 }
                 tempBuffer[tempIndex] = 0;
                 if (index > 0) {
-                    value_t *tempValue = createVariable(tempBuffer);
+                    value_t *tempValue = createVariable(tempBuffer, getNameHash(tempBuffer));
                     if (tempValue == NULL) {
                         reportError(ERROR_MESSAGE_STACK_HEAP_COLLISION, status->startCode);
                         status->result.status = EVALUATION_STATUS_QUIT;
@@ -3900,6 +5914,13 @@ static int8_t __attribute__ ((noinline)) evaluateBinaryOperatorExpression2(expre
             return true;
         }
         localScope = tempPreviousScope;
+        #if VARIABLE_CACHE_SIZE > 0
+            if (variableCacheEpoch == tempPreviousCacheEpoch) {
+                variableCacheScope = tempPreviousCacheScope;
+            } else {
+                renewVariableCacheScope();
+            }
+        #endif
         status->result.value = tempResult2.value;
     } else {
         return false;
@@ -3939,6 +5960,11 @@ static void __attribute__ ((noinline)) evaluateFunction(expressionStatus_t *stat
             return;
         }
         status->argumentList[index] = tempResult2.value;
+        // Control functions, print: and str: handle integers. Other
+        // functions read numbers as floats.
+        if (status->symbol > SYMBOL_QUIT && status->symbol != SYMBOL_PRINT && status->symbol != SYMBOL_STRING) {
+            promoteIntegerValue(status->argumentList + index);
+        }
         tempTreasureTracker2.amount += 1;
         status->code = tempResult2.nextCode;
         if (index < tempArgumentAmount - 1) {
@@ -3971,7 +5997,7 @@ static void __attribute__ ((noinline)) evaluateFunction(expressionStatus_t *stat
             return;
         }
     }
-    if (status->symbol >= SYMBOL_PRINT && status->symbol <= SYMBOL_FILE_IMPORT) {
+    if (status->symbol >= SYMBOL_PRINT && status->symbol <= SYMBOL_FILE_WRITE_NUMBER) {
         evaluateInputOutputFunction(status);
         if (status->result.status != EVALUATION_STATUS_NORMAL) {
             return;
@@ -3993,7 +6019,12 @@ static void __attribute__ ((noinline)) evaluateIgnoredExpression(expressionStatu
             status->result.status = EVALUATION_STATUS_QUIT;
             return;
         }
+        if (skipBlockClause(status)) {
+            return;
+        }
     } else if (status->symbol == SYMBOL_ELSE_IF) {
+        rememberBlockClause(status->branch->address, status->startCode);
+        status->branch->address = status->startCode;
         if (status->branch->action == BRANCH_ACTION_IGNORE_SOFT) {
             status->branch->action = BRANCH_ACTION_RUN;
             expressionResult_t tempResult2 = evaluateExpression(status->code + 1, 99, false);
@@ -4011,20 +6042,28 @@ static void __attribute__ ((noinline)) evaluateIgnoredExpression(expressionStatu
                 status->result.status = EVALUATION_STATUS_QUIT;
                 return;
             }
-            if (tempResult2.value.type != VALUE_TYPE_NUMBER) {
+            if (!valueIsNumber(&(tempResult2.value))) {
                 reportError(ERROR_MESSAGE_BAD_ARGUMENT_TYPE, status->startCode);
                 status->result.status = EVALUATION_STATUS_QUIT;
                 return;
             }
-            if (*(float *)(tempResult2.value.data) != 0.0) {
+            if (!numberValueIsZero(&(tempResult2.value))) {
                 status->branch->action = BRANCH_ACTION_RUN;
             }
         }
+        if (status->branch->action != BRANCH_ACTION_RUN && skipBlockClause(status)) {
+            return;
+        }
     } else if (status->symbol == SYMBOL_ELSE) {
+        rememberBlockClause(status->branch->address, status->startCode);
+        status->branch->address = status->startCode;
         if (status->branch->action == BRANCH_ACTION_IGNORE_SOFT) {
             status->branch->action = BRANCH_ACTION_RUN;
+        } else if (skipBlockClause(status)) {
+            return;
         }
     } else if (status->symbol == SYMBOL_END) {
+        rememberBlockClause(status->branch->address, status->startCode);
         int8_t tempSuccess = popBranch();
         if (!tempSuccess) {
             reportError(ERROR_MESSAGE_BAD_END_STATEMENT, status->startCode);
@@ -4106,6 +6145,8 @@ static expressionResult_t evaluateExpression(int32_t code, int8_t precedence, in
             status->result.status = EVALUATION_STATUS_QUIT;
             return status->result;
         }
+        // The trackers of the functions above are gone with their frames.
+        firstTreasureTracker = &status->treasureTracker;
         while (true) {
             status->symbol = readStorageInt8(status->code);
             int8_t tempResult = evaluateBinaryOperatorExpression2(status);
@@ -4145,6 +6186,46 @@ static expressionResult_t evaluateExpression(int32_t code, int8_t precedence, in
     return status->result;
 }
 
+static void countProfileStatement(int32_t address) {
+    int8_t index = 0;
+    while (index < profile->entryAmount) {
+        profileEntry_t *tempEntry = profile->entryList + index;
+        if (tempEntry->address == address) {
+            if (tempEntry->count < 0xFFFF) {
+                tempEntry->count += 1;
+            }
+            return;
+        }
+        index += 1;
+    }
+    if (profile->entryAmount < PROFILE_ENTRY_AMOUNT) {
+        profileEntry_t *tempEntry = profile->entryList + profile->entryAmount;
+        tempEntry->address = address;
+        tempEntry->count = 1;
+        tempEntry->error = 0;
+        profile->entryAmount += 1;
+        return;
+    }
+    profileEntry_t *tempEntry = profile->entryList;
+    index = 1;
+    while (index < PROFILE_ENTRY_AMOUNT) {
+        if (profile->entryList[index].count < tempEntry->count) {
+            tempEntry = profile->entryList + index;
+        }
+        index += 1;
+    }
+    uint16_t tempOtherCount = profile->otherCount + (tempEntry->count - tempEntry->error);
+    if (tempOtherCount < profile->otherCount) {
+        tempOtherCount = 0xFFFF;
+    }
+    profile->otherCount = tempOtherCount;
+    tempEntry->address = address;
+    tempEntry->error = tempEntry->count;
+    if (tempEntry->count < 0xFFFF) {
+        tempEntry->count += 1;
+    }
+}
+
 static expressionResult_t runCode(int32_t address) {
     treasureTracker_t *tempTreasureTracker = firstTreasureTracker;
     while (true) {
@@ -4158,6 +6239,9 @@ static expressionResult_t runCode(int32_t address) {
             tempResult.value.type = VALUE_TYPE_MISSING;
             return tempResult;
         } else {
+            if (profile != NULL) {
+                countProfileStatement(address);
+            }
             expressionResult_t tempResult = evaluateExpression(address, 99, true);
             firstTreasureTracker = tempTreasureTracker;
             if (tempResult.status == EVALUATION_STATUS_QUIT) {
@@ -4173,6 +6257,7 @@ static expressionResult_t runCode(int32_t address) {
         if (allocationsSinceMarkAndSweep > 5 || commandsSinceMarkAndSweep > 30) {
             markAndSweep();
         }
+        serviceStorageWrites();
         if (escapeKeyIsPressed()) {
             expressionResult_t tempResult;
             tempResult.destination = NULL;
@@ -4185,7 +6270,13 @@ static expressionResult_t runCode(int32_t address) {
 
 static void runFile(int32_t address) {
     errorMessage = NULL;
+    errorCode = 0;
+    closeAllFileHandles();
     resetHeap();
+    forgetCodeCaches();
+    resetStorageStatistics();
+    resetMemoryStatistics();
+    paintNativeStack();
     firstTreasureTracker = NULL;
     commandsSinceMarkAndSweep = 0;
     allocationsSinceMarkAndSweep = 0;
@@ -4194,8 +6285,9 @@ static void runFile(int32_t address) {
     displayTextFromProgMem(0, 0, MESSAGE_RUNNING);
     globalScope = memory;
     localScope = memory;
+    renewVariableCacheScope();
     *(int16_t *)(globalScope + SCOPE_SIZE_OFFSET) = 0;
-    *(int8_t **)(globalScope + SCOPE_VARIABLE_OFFSET) = NULL;
+    memset(globalScope + SCOPE_VARIABLE_OFFSET, 0, SCOPE_BUCKET_AMOUNT * sizeof(int8_t *));
     *(branch_t **)(globalScope + SCOPE_BRANCH_OFFSET) = NULL;
     int8_t tempSuccess = pushBranch(BRANCH_ACTION_RUN, 0);
     if (!tempSuccess) {
@@ -4204,10 +6296,15 @@ static void runFile(int32_t address) {
     treasureTracker_t tempTreasureTracker;
     initializeTreasureTracker(&tempTreasureTracker, TREASURE_TYPE_SCOPE, localScope);
     runCode(tempCode);
+    flushStorageWrites();
+    memoryStatistics[MEMORY_STATISTIC_NATIVE_STACK_FREE] = getNativeStackFree();
     resetHeap();
     localScope = NULL;
     if (errorMessage) {
         printTextFromProgMem(errorMessage);
+    }
+    // Some errors are reported without the code which caused them.
+    if (errorMessage && errorCode >= FILE_VIRTUAL_ADDRESS) {
         int32_t tempFileDataStartAddress = errorCode - errorCode % FILE_ENTRY_SIZE + FILE_DATA_OFFSET;
         int32_t tempStartAddress = errorCode;
         int32_t tempEndAddress = errorCode;
@@ -4233,9 +6330,95 @@ static void runFile(int32_t address) {
     }
 }
 
+// Writes one line per profiled source line to the file PROFILE,
+// busiest line first. Lines in other files (fImport:) are prefixed
+// with the name of the file. A line which replaced an evicted entry
+// is written with the range of its possible counts, such as
+// "L4 10..13". Other holds the counts of the evicted lines.
+static void writeProfile(int32_t address) {
+    int8_t index = 1;
+    while (index < profile->entryAmount) {
+        profileEntry_t tempEntry = profile->entryList[index];
+        int8_t tempIndex = index;
+        while (tempIndex > 0 && profile->entryList[tempIndex - 1].count < tempEntry.count) {
+            profile->entryList[tempIndex] = profile->entryList[tempIndex - 1];
+            tempIndex -= 1;
+        }
+        profile->entryList[tempIndex] = tempEntry;
+        index += 1;
+    }
+    int8_t *tempText = memory;
+    int16_t tempLength = 0;
+    index = 0;
+    while (index < profile->entryAmount) {
+        profileEntry_t *tempEntry = profile->entryList + index;
+        int32_t tempFile = tempEntry->address - tempEntry->address % FILE_ENTRY_SIZE;
+        if (tempFile != address) {
+            readStorage(tempText + tempLength, tempFile + FILE_NAME_OFFSET, FILE_NAME_MAXIMUM_LENGTH + 1);
+            tempLength += strlen(tempText + tempLength);
+            tempText[tempLength] = ':';
+            tempLength += 1;
+        }
+        int16_t tempLineNumber = 1;
+        int32_t tempAddress = tempFile + FILE_DATA_OFFSET;
+        while (tempAddress < tempEntry->address) {
+            if (readStorageInt8(tempAddress) == '\n') {
+                tempLineNumber += 1;
+            }
+            tempAddress += 1;
+        }
+        tempText[tempLength] = 'L';
+        tempLength += 1;
+        itoa(tempLineNumber, tempText + tempLength, 10);
+        tempLength += strlen(tempText + tempLength);
+        tempText[tempLength] = ' ';
+        tempLength += 1;
+        if (tempEntry->error > 0) {
+            ultoa(tempEntry->count - tempEntry->error, tempText + tempLength, 10);
+            tempLength += strlen(tempText + tempLength);
+            tempText[tempLength] = '.';
+            tempText[tempLength + 1] = '.';
+            tempLength += 2;
+        }
+        ultoa(tempEntry->count, tempText + tempLength, 10);
+        tempLength += strlen(tempText + tempLength);
+        tempText[tempLength] = '\n';
+        tempLength += 1;
+        index += 1;
+    }
+    readProgMemText(tempText + tempLength, MESSAGE_PROFILE_OTHER);
+    tempLength += strlen(tempText + tempLength);
+    ultoa(profile->otherCount, tempText + tempLength, 10);
+    int8_t tempName[] = PROFILE_FILE_NAME;
+    int32_t tempProfileFile = fileFindByName(tempName);
+    if (tempProfileFile < 0) {
+        tempProfileFile = fileCreate(tempName);
+        if (tempProfileFile < 0) {
+            printTextFromProgMem(errorMessage);
+            return;
+        }
+    }
+    fileWrite(tempProfileFile, tempText);
+    printTextFromProgMem(MESSAGE_PROFILE_SAVED);
+}
+
+static void runFileWithProfile(int32_t address) {
+    profile_t tempProfile;
+    tempProfile.otherCount = 0;
+    tempProfile.entryAmount = 0;
+    profile = &tempProfile;
+    runFile(address);
+    writeProfile(address);
+    profile = NULL;
+}
+
 static void editFile(int32_t address) {
     int16_t tempSize;
     readStorage(&tempSize, address + FILE_SIZE_OFFSET, 2);
+    if (tempSize > FILE_MAXIMUM_SIZE) {
+        printTextFromProgMem(ERROR_MESSAGE_FILE_IS_TOO_LARGE);
+        return;
+    }
     readStorage(memory, address + FILE_DATA_OFFSET, tempSize + 1);
     initializeTextEditor(memory, FILE_MAXIMUM_SIZE, false);
     while (true) {
@@ -4250,8 +6433,14 @@ static void editFile(int32_t address) {
                 clearDisplay();
                 displayTextFromProgMem(0, 0, MESSAGE_SAVING);
                 tempSize = strlen(memory);
-                writeStorage(address + FILE_SIZE_OFFSET, &tempSize, 2);
-                writeStorage(address + FILE_DATA_OFFSET, memory, tempSize + 1);
+                if (!fileSetCapacity(address, tempSize)) {
+                    printTextFromProgMem(errorMessage);
+                    continue;
+                }
+                // The size lives in the directory entry and the text
+                // in the allocation units of the file.
+                writeChangedStorage(address + FILE_SIZE_OFFSET, &tempSize, 2);
+                writeChangedStorage(address + FILE_DATA_OFFSET, memory, tempSize + 1);
                 printTextFromProgMem(MESSAGE_FILE_SAVED);
             }
             if (tempResult == 1) {
@@ -4285,6 +6474,7 @@ static void promptFileAction(int32_t address) {
         }
         if (tempResult == 0) {
             runFile(address);
+            printStatistics(MEMORY_STATISTIC_NAME_LIST, memoryStatistics, MEMORY_STATISTIC_AMOUNT);
         }
         if (tempResult == 1) {
             editFile(address);
@@ -4303,77 +6493,135 @@ static void promptFileAction(int32_t address) {
                 break;
             }
         }
+        if (tempResult == 5) {
+            runFileWithProfile(address);
+            printStatistics(MEMORY_STATISTIC_NAME_LIST, memoryStatistics, MEMORY_STATISTIC_AMOUNT);
+        }
+        if (tempResult == 6) {
+            promptCopyFile(address);
+        }
+    }
+}
+
+// Shows one option of the file list. Option 0 creates a file, the
+// last option shows diagnostics, and the others are files, whose
+// names are read from the directory only when shown.
+static int8_t displayFileListOption(void *context, int16_t index) {
+    fileList_t *tempFileList = context;
+    if (index == 0) {
+        displayTextFromProgMem(1, 1, MENU_OPTION_CREATE_FILE);
+    } else if (index > tempFileList->amount) {
+        displayTextFromProgMem(1, 1, MENU_OPTION_DIAGNOSTICS);
+    } else {
+        int8_t tempName[FILE_NAME_MAXIMUM_LENGTH + 1];
+        readStorage(tempName, getFileAddress(tempFileList->indexList[index - 1]) + FILE_NAME_OFFSET, FILE_NAME_MAXIMUM_LENGTH + 1);
+        displayText(1, 1, tempName);
     }
+    return true;
+}
+
+// Works like listMenu, but does not need any heap memory.
+static int8_t fileListMenu(fileList_t *fileList) {
+    clearDisplay();
+    displayTextFromProgMem(0, 0, MENU_TITLE_FILE_LIST);
+    return menu(fileList->amount + 2, displayFileListOption, fileList);
 }
 
 static void mainMenu() {
     while (true) {
-        int8_t tempFileAmount = 0;
-        int32_t tempAddress = 0;
-        while (tempAddress < STORAGE_SIZE) {
-            uint8_t tempExists;
-            readStorage(&tempExists, tempAddress + FILE_EXISTS_OFFSET, 1);
-            if (tempExists == FILE_EXISTS_TRUE) {
-                tempFileAmount += 1;
-            }
-            tempAddress += FILE_ENTRY_SIZE;
-        }
-        int8_t tempListLength = tempFileAmount + 1;
-        int8_t *tempList = createEmptyList(tempListLength);
-        value_t *tempListContents = (value_t *)(*(int8_t **)tempList + LIST_DATA_OFFSET);
-        int8_t *tempString = createStringFromProgMem(MENU_OPTION_CREATE_FILE);
-        value_t *tempValue = tempListContents + 0;
-        tempValue->type = VALUE_TYPE_STRING;
-        *(int8_t **)&(tempValue->data) = tempString;
-        int8_t index = 1;
-        tempAddress = 0;
-        while (tempAddress < STORAGE_SIZE) {
-            uint8_t tempExists;
-            readStorage(&tempExists, tempAddress + FILE_EXISTS_OFFSET, 1);
-            if (tempExists == FILE_EXISTS_TRUE) {
-                volatile int16_t tempCheatSize = FILE_NAME_MAXIMUM_LENGTH + 1;
-                int8_t tempName[tempCheatSize];
-                readStorage(tempName, tempAddress + FILE_NAME_OFFSET, FILE_NAME_MAXIMUM_LENGTH + 1);
-                int8_t *tempString = createString(tempName);
-                value_t *tempValue = tempListContents + index;
-                tempValue->type = VALUE_TYPE_STRING;
-                *(int8_t **)&(tempValue->data) = tempString;
-                index += 1;
+        fileList_t tempFileList;
+        tempFileList.amount = 0;
+        int8_t index = 0;
+        while (index < FILE_AMOUNT) {
+            if (fileExists(index)) {
+                tempFileList.indexList[tempFileList.amount] = index;
+                tempFileList.amount += 1;
             }
-            tempAddress += FILE_ENTRY_SIZE;
-        }
-        int8_t tempResult = menuWithTitleFromProgMem(MENU_TITLE_FILE_LIST, tempList);
-        index = 0;
-        while (index < tempListLength) {
-            value_t *tempValue = tempListContents + index;
-            int8_t *tempString = *(int8_t **)&(tempValue->data);
-            deallocatePointer(tempString);
             index += 1;
         }
-        deallocatePointer(tempList);
+        int8_t tempResult = fileListMenu(&tempFileList);
         if (tempResult == 0) {
             promptCreateFile();
+        } else if (tempResult == tempFileList.amount + 1) {
+            // Both describe the last file which ran.
+            printStatistics(STORAGE_STATISTIC_NAME_LIST, storageStatistics, STORAGE_STATISTIC_AMOUNT);
+            printStatistics(MEMORY_STATISTIC_NAME_LIST, memoryStatistics, MEMORY_STATISTIC_AMOUNT);
         } else if (tempResult > 0) {
-            int8_t index = 1;
-            tempAddress = 0;
-            while (tempAddress < STORAGE_SIZE) {
-                uint8_t tempExists;
-                readStorage(&tempExists, tempAddress + FILE_EXISTS_OFFSET, 1);
-                if (tempExists == FILE_EXISTS_TRUE) {
-                    if (index == tempResult) {
-                        break;
-                    }
-                    index += 1;
-                }
-                tempAddress += FILE_ENTRY_SIZE;
-            }
-            promptFileAction(tempAddress);
+            promptFileAction(getFileAddress(tempFileList.indexList[tempResult - 1]));
+        }
+    }
+}
+
+#ifdef IS_BENCHMARK
+
+// Runs the file BENCH between writes to GPIOR0.
+// The simavr harness in bench/ counts the cycles between them.
+static void runBenchmark() {
+    int8_t tempName[] = BENCHMARK_FILE_NAME;
+    int32_t tempFile = fileFindByName(tempName);
+    if (tempFile < 0) {
+        GPIOR0 = BENCHMARK_MARKER_MISSING_FILE;
+    } else {
+        GPIOR0 = BENCHMARK_MARKER_START;
+        runFile(tempFile);
+        if (errorMessage == NULL) {
+            GPIOR0 = BENCHMARK_MARKER_END;
+        } else {
+            GPIOR0 = BENCHMARK_MARKER_ERROR;
+        }
+    }
+    while (true) {
+        
+    }
+}
+
+#endif
+
+#ifdef IS_EMULATOR
+
+const int8_t *getEmulatorSymbolText(uint8_t symbol) {
+    if (symbol < 128 || symbol > LAST_FUNCTION_SYMBOL) {
+        return NULL;
+    }
+    return pgm_read_ptr((const void **)(SYMBOL_TEXT_LIST + (symbol - 128)));
+}
+
+int8_t importEmulatorFile(int8_t *name, int8_t *text) {
+    int32_t tempFile = fileFindByName(name);
+    if (tempFile < 0) {
+        tempFile = fileCreate(name);
+        if (tempFile < 0) {
+            return false;
         }
     }
+    return fileWrite(tempFile, text);
+}
+
+void initializeEmulatorStorage() {
+    initializeFileSystem();
+}
+
+int8_t runEmulatorFile(int8_t *name) {
+    int32_t tempFile = fileFindByName(name);
+    if (tempFile < 0) {
+        return false;
+    }
+    runFile(tempFile);
+    return true;
 }
 
+int main(int argc, char **argv) {
+    
+    initializeEmulator(argc, argv);
+    
+#else
+
 int main(void) {
     
+#endif
+    
+    paintNativeStack();
+    
     DISPLAY_CLOCK_PIN_LOW;
     BUTTON_INPUT_PINS_LOW;
     BUTTON_OUTPUT_PINS_HIGH;
@@ -4394,6 +6642,9 @@ int main(void) {
     SPCR = (1 << SPE) | (1 << MSTR);
     SPSR |= (1 << SPI2X);
     
+    // Timer 1 runs freely for memory statistics.
+    TCCR1B = (1 << CS11) | (1 << CS10);
+    
     // 4-bit display operation.
     _delay_ms(30);
     sendDisplayCommandInt4(0x03);
@@ -4435,6 +6686,13 @@ int main(void) {
     // Turn display on.
     sendDisplayCommand(0x0C);
     
+    // Needs the display to report a storage which cannot be converted.
+    initializeFileSystem();
+    
+    #ifdef IS_BENCHMARK
+        runBenchmark();
+    #endif
+    
     displayTextFromProgMem(0, 0, MESSAGE_WELCOME);
     int32_t tempSeed = 0;
     while (getPressedKey() < 0) {
@@ -0,0 +1,37 @@
+#!/bin/sh
+# Usage: run-tests.sh HOST_EMULATOR KEY_SCRIPT PROGRAM...
+# Runs each ChipOS program in a fresh storage image and compares what
+# it prints with the file of the same name in tests/expected. A program
+# with an image of the same name in tests/images starts from a copy of
+# that image instead. Prints a tab-separated table with one row per
+# program, and exits with status 1 if any program printed something
+# else.
+
+EMULATOR="$1"
+KEYS="$2"
+shift 2
+
+DIRECTORY=$(dirname "$0")
+IMAGE=$(mktemp)
+OUTPUT=$(mktemp)
+trap 'rm -f "$IMAGE" "$OUTPUT"' EXIT
+
+STATUS=0
+printf 'program\tstatus\n'
+for PROGRAM in "$@"; do
+    NAME=$(basename "$PROGRAM" .txt)
+    rm -f "$IMAGE"
+    if [ -f "$DIRECTORY/images/$NAME.img" ]; then
+        cp "$DIRECTORY/images/$NAME.img" "$IMAGE"
+    fi
+    # Lines starting with "+" or "|" are display snapshots.
+    "$EMULATOR" -k "$KEYS" -i TEST="$PROGRAM" -r TEST "$IMAGE" 2>&1 | grep -av '^[+|]' > "$OUTPUT"
+    if cmp -s "$OUTPUT" "$DIRECTORY/expected/$NAME.txt"; then
+        printf '%s\tok\n' "$NAME"
+    else
+        printf '%s\tfailed\n' "$NAME"
+        diff "$DIRECTORY/expected/$NAME.txt" "$OUTPUT" | sed 's/^/    /'
+        STATUS=1
+    fi
+done
+exit $STATUS